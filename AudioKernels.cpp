@@ -0,0 +1,192 @@
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#define AUDIO_KERNELS_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+float dotProduct(const float* a, const float* b, size_t count)
+{
+    float  sum = 0.f;
+    size_t i   = 0;
+
+#if defined(AUDIO_KERNELS_AVX2)
+    __m256 sums = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8)
+    {
+        sums = _mm256_add_ps(sums, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, sums);
+    for (float lane : lanes)
+    {
+        sum += lane;
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    __m128 sums = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        sums = _mm_add_ps(sums, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, sums);
+    for (float lane : lanes)
+    {
+        sum += lane;
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+float peakOf(const float* samples, size_t count)
+{
+    float  peak = 0.f;
+    size_t i    = 0;
+
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256       peaks   = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8)
+    {
+        peaks = _mm256_max_ps(peaks, _mm256_and_ps(_mm256_loadu_ps(samples + i), absMask));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, peaks);
+    for (float lane : lanes)
+    {
+        peak = std::max(peak, lane);
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128       peaks   = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        peaks = _mm_max_ps(peaks, _mm_and_ps(_mm_loadu_ps(samples + i), absMask));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peaks);
+    for (float lane : lanes)
+    {
+        peak = std::max(peak, lane);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        peak = std::max(peak, std::fabs(samples[i]));
+    }
+    return peak;
+}
+
+void rangeOf(const float* samples, size_t count, float& outMin, float& outMax)
+{
+    float  low  = count ? samples[0] : 0.f;
+    float  high = low;
+    size_t i    = 0;
+
+#if defined(AUDIO_KERNELS_AVX2)
+    __m256 lows  = _mm256_set1_ps(low);
+    __m256 highs = lows;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 values = _mm256_loadu_ps(samples + i);
+        lows          = _mm256_min_ps(lows, values);
+        highs         = _mm256_max_ps(highs, values);
+    }
+    alignas(32) float lowLanes[8];
+    alignas(32) float highLanes[8];
+    _mm256_store_ps(lowLanes, lows);
+    _mm256_store_ps(highLanes, highs);
+    for (size_t lane = 0; lane < 8; ++lane)
+    {
+        low  = std::min(low, lowLanes[lane]);
+        high = std::max(high, highLanes[lane]);
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    __m128 lows  = _mm_set1_ps(low);
+    __m128 highs = lows;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 values = _mm_loadu_ps(samples + i);
+        lows          = _mm_min_ps(lows, values);
+        highs         = _mm_max_ps(highs, values);
+    }
+    alignas(16) float lowLanes[4];
+    alignas(16) float highLanes[4];
+    _mm_store_ps(lowLanes, lows);
+    _mm_store_ps(highLanes, highs);
+    for (size_t lane = 0; lane < 4; ++lane)
+    {
+        low  = std::min(low, lowLanes[lane]);
+        high = std::max(high, highLanes[lane]);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        low  = std::min(low, samples[i]);
+        high = std::max(high, samples[i]);
+    }
+    outMin = low;
+    outMax = high;
+}
+
+void multiplyAdd(float* target, const float* source, float factor, size_t count)
+{
+    size_t i = 0;
+
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 factors = _mm256_set1_ps(factor);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 product = _mm256_mul_ps(_mm256_loadu_ps(source + i), factors);
+        _mm256_storeu_ps(target + i, _mm256_add_ps(_mm256_loadu_ps(target + i), product));
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 factors = _mm_set1_ps(factor);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(source + i), factors);
+        _mm_storeu_ps(target + i, _mm_add_ps(_mm_loadu_ps(target + i), product));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        target[i] += source[i] * factor;
+    }
+}
+
+void scale(float* samples, float factor, size_t count)
+{
+    size_t i = 0;
+
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 factors = _mm256_set1_ps(factor);
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), factors));
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 factors = _mm_set1_ps(factor);
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), factors));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        samples[i] *= factor;
+    }
+}
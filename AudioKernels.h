@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+// Loops over float samples shared by the audio analysis and processing. Vectorized with AVX2 or SSE2 when the
+// target has them, scalar otherwise. Pointers need no particular alignment.
+
+float dotProduct(const float* a, const float* b, size_t count);
+
+// Largest absolute value
+float peakOf(const float* samples, size_t count);
+
+// Smallest and largest value, both 0 for no samples
+void rangeOf(const float* samples, size_t count, float& outMin, float& outMax);
+
+// target[i] += source[i] * factor
+void multiplyAdd(float* target, const float* source, float factor, size_t count);
+
+// samples[i] *= factor
+void scale(float* samples, float factor, size_t count);
@@ -0,0 +1,397 @@
+#include "AudioPipeline.h"
+#include "AudioKernels.h"
+#include "vlc/vlc.h"
+#include <SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// LITERALS
+static const int         kOutputSampleRate  = 48000;
+static const int         kOutputChannels    = 2;
+static const int         kOutputBlockFrames = 512;  // ~10 ms, the latency of the device callback
+static const int         kInputBufferMs     = 250;  // per input, decoders run at most this far ahead
+static const char* const kInputFormat       = "FL32";
+static const int         kSilenceChunkMs    = 10;
+static const std::chrono::milliseconds kWriteRetryInterval(2);
+// a decoder waiting longer than this for room drops the samples instead, no consumer is reading
+static const std::chrono::milliseconds kMaxWriteWait(1000);
+
+AudioPipeline::~AudioPipeline()
+{
+    if (_device)
+    {
+        SDL_CloseAudioDevice(_device);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+}
+
+bool AudioPipeline::init()
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+    {
+        std::cout << "Failed to init SDL audio: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    SDL_AudioSpec desired {};
+    desired.freq     = kOutputSampleRate;
+    desired.format   = AUDIO_F32SYS;
+    desired.channels = kOutputChannels;
+    desired.samples  = kOutputBlockFrames;
+    desired.callback = &AudioPipeline::onOutput;
+    desired.userdata = this;
+
+    // no changes allowed, SDL converts if the device wants another format
+    SDL_AudioSpec obtained {};
+    _device = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
+    if (_device == 0)
+    {
+        std::cout << "Failed to open audio device: " << SDL_GetError() << std::endl;
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+
+    _format             = {obtained.freq, obtained.channels};
+    _maxFrames          = obtained.samples;
+    _silenceChunkFrames = size_t(_format.sampleRate * kSilenceChunkMs / 1000);
+    for (auto& input : _inputs)
+    {
+        input.owner = this;
+        input.stretcher.prepare(_format.sampleRate, _format.channels);
+        // room for the stretcher's tail with a couple of output blocks left over, see onDrain()
+        size_t ringFrames = std::max(size_t(_format.sampleRate) * kInputBufferMs / 1000,
+                                     input.stretcher.maxTailFrames() + 2 * _maxFrames);
+        input.ring.reset(ringFrames * _format.channels);
+    }
+    SDL_PauseAudioDevice(_device, 0);
+    return true;
+}
+
+void AudioPipeline::attach(libvlc_media_player_t* player, size_t input)
+{
+    libvlc_audio_set_format(player, kInputFormat, unsigned(_format.sampleRate), unsigned(_format.channels));
+    libvlc_audio_set_callbacks(player, &AudioPipeline::onPlay, &AudioPipeline::onPause, &AudioPipeline::onResume,
+                               &AudioPipeline::onFlush, &AudioPipeline::onDrain, &_inputs[input]);
+}
+
+void AudioPipeline::setActiveInput(size_t input)
+{
+    _activeInput.store(input, std::memory_order_release);
+}
+
+void AudioPipeline::flush(size_t input)
+{
+    Input& target   = _inputs[input];
+    size_t position = target.ring.writePosition();
+    if (target.endPosition.load(std::memory_order_acquire) == position)
+    {
+        // the stream ended by itself, its tail may still be playing
+        return;
+    }
+    target.paused = false;
+    target.flushTo.store(position, std::memory_order_release);
+}
+
+void AudioPipeline::startStream(size_t input, int64_t positionMs, std::shared_ptr<const SilenceMap> silences,
+                                float gain)
+{
+    Input& target   = _inputs[input];
+    target.silences = std::move(silences);
+    target.gain     = gain;
+    target.seekTo   = -1;
+    target.stretcher.reset();
+    setStreamPosition(target, positionMs);
+}
+
+void AudioPipeline::seekStream(size_t input, int64_t positionMs)
+{
+    _inputs[input].seekTo = positionMs;
+}
+
+void AudioPipeline::setSilenceSkip(bool enabled, int64_t maxPauseMs)
+{
+    _maxPauseFrames = std::max<int64_t>(maxPauseMs, 0) * _format.sampleRate / 1000;
+    _skipSilence    = enabled;
+}
+
+void AudioPipeline::setNormalization(bool enabled)
+{
+    _normalize = enabled;
+}
+
+void AudioPipeline::setSpeed(float speed)
+{
+    _speed = speed;
+}
+
+void AudioPipeline::setStreamPosition(Input& input, int64_t positionMs)
+{
+    input.streamFrame   = positionMs * _format.sampleRate / 1000;
+    input.silenceCursor = 0;
+    input.silentFrames  = 0;
+}
+
+void AudioPipeline::addStage(AudioStage& stage)
+{
+    stage.prepare(_format, _maxFrames);
+    SDL_LockAudioDevice(_device);
+    _stages.push_back(&stage);
+    SDL_UnlockAudioDevice(_device);
+}
+
+void AudioPipeline::removeStage(AudioStage& stage)
+{
+    SDL_LockAudioDevice(_device);
+    _stages.erase(std::remove(_stages.begin(), _stages.end(), &stage), _stages.end());
+    SDL_UnlockAudioDevice(_device);
+}
+
+void AudioPipeline::onPlay(void* data, const void* samples, unsigned count, int64_t /*pts*/)
+{
+    Input&         input    = *static_cast<Input*>(data);
+    AudioPipeline& self     = *input.owner;
+    size_t         channels = size_t(self._format.channels);
+    const float*   source   = static_cast<const float*>(samples);
+    if (self._normalize && input.gain != 1.f)
+    {
+        // grows to the decoder's block size once
+        size_t length = size_t(count) * channels;
+        if (input.amplified.size() < length)
+        {
+            input.amplified.resize(length);
+        }
+        std::copy(source, source + length, input.amplified.data());
+        scale(input.amplified.data(), input.gain, length);
+        source = input.amplified.data();
+    }
+    if (!self._skipSilence)
+    {
+        self.writeAtSpeed(input, source, count);
+        input.streamFrame += count;
+        return;
+    }
+
+    // decided per chunk, the kept part of a pause is its start
+    for (size_t offset = 0; offset < count; offset += self._silenceChunkFrames)
+    {
+        size_t       frames = std::min(self._silenceChunkFrames, size_t(count) - offset);
+        const float* chunk  = source + offset * channels;
+        self.writeAtSpeed(input, chunk, self.framesToKeep(input, chunk, frames));
+        input.streamFrame += int64_t(frames);
+    }
+}
+
+size_t AudioPipeline::framesToKeep(Input& input, const float* samples, size_t frames)
+{
+    bool silent = false;
+    if (input.silences)
+    {
+        int64_t positionMs = (input.streamFrame + int64_t(frames) / 2) * 1000 / _format.sampleRate;
+        silent             = isInSilence(*input.silences, positionMs, input.silenceCursor);
+    }
+    else
+    {
+        silent = isSilent(measureLevel(samples, frames * size_t(_format.channels)));
+    }
+    if (!silent)
+    {
+        input.silentFrames = 0;
+        return frames;
+    }
+
+    int64_t maxPause = _maxPauseFrames;
+    size_t  keep     = size_t(std::clamp<int64_t>(maxPause - input.silentFrames, 0, int64_t(frames)));
+    input.silentFrames += int64_t(frames);
+    return keep;
+}
+
+void AudioPipeline::writeAtSpeed(Input& input, const float* samples, size_t frames)
+{
+    TimeStretcher& stretcher = input.stretcher;
+    float          speed     = _speed;
+    if (speed == 1.f)
+    {
+        if (stretcher.hasInput())
+        {
+            // back to normal, what the stretcher holds comes first
+            const float* tail   = nullptr;
+            size_t       length = stretcher.finish(tail);
+            write(input, tail, length);
+        }
+        write(input, samples, frames);
+        return;
+    }
+
+    size_t channels = size_t(_format.channels);
+    while (frames > 0)
+    {
+        size_t taken = stretcher.write(samples, frames);
+        samples += taken * channels;
+        frames -= taken;
+        bool produced = false;
+        while (const float* hop = stretcher.next(speed))
+        {
+            write(input, hop, stretcher.hopFrames());
+            produced = true;
+        }
+        if (taken == 0 && !produced)
+        {
+            // can't happen with a sane capacity, better dropping than spinning
+            break;
+        }
+    }
+}
+
+void AudioPipeline::write(Input& input, const float* samples, size_t frames)
+{
+    size_t       channels  = size_t(input.owner->_format.channels);
+    const float* source    = samples;
+    size_t       remaining = frames * channels;
+    auto         deadline  = std::chrono::steady_clock::now() + kMaxWriteWait;
+
+    // blocking here is what paces the decoder to the output
+    while (remaining > 0)
+    {
+        // whole frames only
+        size_t room    = input.ring.writeAvailable() / channels * channels;
+        size_t written = input.ring.write(source, std::min(remaining, room));
+        source += written;
+        remaining -= written;
+        if (remaining == 0 || std::chrono::steady_clock::now() >= deadline)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(kWriteRetryInterval);
+    }
+}
+
+void AudioPipeline::onPause(void* data, int64_t /*pts*/)
+{
+    static_cast<Input*>(data)->paused = true;
+}
+
+void AudioPipeline::onResume(void* data, int64_t /*pts*/)
+{
+    static_cast<Input*>(data)->paused = false;
+}
+
+void AudioPipeline::onFlush(void* data, int64_t /*pts*/)
+{
+    Input& input = *static_cast<Input*>(data);
+    input.stretcher.reset();
+    input.flushTo.store(input.ring.writePosition(), std::memory_order_release);
+    int64_t seekTo = input.seekTo.exchange(-1);
+    if (seekTo >= 0)
+    {
+        input.owner->setStreamPosition(input, seekTo);
+    }
+}
+
+void AudioPipeline::onDrain(void* data)
+{
+    // Only waits for room for the stretcher's tail. The output frees it within the tail's own length and, the ring
+    // holding more than the tail, still has samples to play meanwhile, so it doesn't reach the end before it's
+    // marked. Then returns so the player reports the end and the next file starts filling its input.
+    Input& input = *static_cast<Input*>(data);
+    if (input.stretcher.hasInput())
+    {
+        const float* tail   = nullptr;
+        size_t       length = input.stretcher.finish(tail);
+        write(input, tail, length);
+    }
+    input.endPosition.store(input.ring.writePosition(), std::memory_order_release);
+}
+
+void AudioPipeline::onOutput(void* userData, uint8_t* stream, int length)
+{
+    AudioPipeline& self = *static_cast<AudioPipeline*>(userData);
+    self.output(reinterpret_cast<float*>(stream), size_t(length) / sizeof(float) / size_t(self._format.channels));
+}
+
+void AudioPipeline::output(float* samples, size_t frames)
+{
+    for (auto& input : _inputs)
+    {
+        applyFlush(input, &input == &_inputs[_currentInput]);
+    }
+
+    size_t channels = size_t(_format.channels);
+    size_t total    = frames * channels;
+    size_t done     = 0;
+    while (done < total)
+    {
+        Input& input = _inputs[_currentInput];
+        if (input.paused)
+        {
+            break;
+        }
+
+        size_t wanted   = total - done;
+        size_t end      = input.endPosition.load(std::memory_order_acquire);
+        bool   isEnding = end != kNoPosition && end >= input.ring.readPosition();
+        if (isEnding)
+        {
+            wanted = std::min(wanted, end - input.ring.readPosition());
+        }
+        done += input.ring.read(samples + done, wanted);
+        if (done == total)
+        {
+            break;
+        }
+
+        bool reachedEnd = isEnding && input.ring.readPosition() == end;
+        if (reachedEnd)
+        {
+            // anything after the end belongs to a new stream of the same input
+            input.endPosition.compare_exchange_strong(end, kNoPosition);
+        }
+        size_t active = _activeInput.load(std::memory_order_acquire);
+        if (active != _currentInput && (reachedEnd || input.ring.readAvailable() == 0))
+        {
+            _currentInput = active;
+            applyFlush(_inputs[_currentInput], true);
+        }
+        else if (!reachedEnd)
+        {
+            // underrun, or the book ended
+            break;
+        }
+    }
+    std::fill(samples + done, samples + total, 0.f);
+
+    for (AudioStage* stage : _stages)
+    {
+        stage->process(samples, frames);
+    }
+}
+
+void AudioPipeline::applyFlush(Input& input, bool isCurrent)
+{
+    size_t flushTo = input.flushTo.exchange(kNoPosition, std::memory_order_acq_rel);
+    if (flushTo == kNoPosition)
+    {
+        return;
+    }
+
+    // the reader may already be past it, a flush landing while output() was reading
+    size_t readPosition = input.ring.readPosition();
+    if (flushTo > readPosition)
+    {
+        input.ring.discard(flushTo - readPosition);
+    }
+    size_t end = input.endPosition.load(std::memory_order_acquire);
+    if (end != kNoPosition && end <= flushTo)
+    {
+        input.endPosition.compare_exchange_strong(end, kNoPosition);
+    }
+    if (isCurrent)
+    {
+        for (AudioStage* stage : _stages)
+        {
+            stage->reset();
+        }
+    }
+}
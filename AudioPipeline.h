@@ -0,0 +1,141 @@
+#pragma once
+
+#include "SilenceDetector.h"
+#include "SpscRing.h"
+#include "TimeStretcher.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+struct libvlc_media_player_t;
+
+struct AudioFormat
+{
+    int sampleRate {0};
+    int channels {0};
+};
+
+// One step of the sample processing chain. process() runs on the audio thread and must not allocate, lock or
+// block, everything it needs is set up in prepare().
+class AudioStage
+{
+public:
+    virtual ~AudioStage() = default;
+
+    // Before the stage joins a chain, maxFrames is the largest block process() will get
+    virtual void prepare(const AudioFormat& format, size_t maxFrames) = 0;
+    // Interleaved samples, frames * channels of them, processed in place
+    virtual void process(float* samples, size_t frames) = 0;
+    // The stream jumped (a seek, another book), drop any history
+    virtual void reset()
+    {
+    }
+};
+
+// Takes decoded audio out of libVLC and plays it through SDL, with a chain of stages in between.
+// Every attached media player is one input with its own ring buffer, filled from the player's decoder thread by
+// the libVLC audio callbacks. The SDL callback reads from one input at a time: when the active input changes it
+// keeps reading the previous one up to the end of its stream before moving on, so consecutive files join
+// seamlessly. Samples are 32 bit float throughout, libVLC converts to the output's rate and channels.
+// Pauses longer than the configured maximum are shortened before the samples are buffered, which makes the decoder
+// run ahead through them. Where a file's silences are known from the library they are looked up, otherwise the
+// samples are measured as they come. Speeds other than 1 are applied there as well, by a time stretcher per input,
+// so the decoders run at the speed and the players' positions stay positions in the files. Loudness normalization
+// is a gain per stream, applied first.
+class AudioPipeline
+{
+public:
+    static const size_t kInputCount = 2;
+
+    AudioPipeline() = default;
+    ~AudioPipeline();
+
+    // Opens the default output device, false if there is none
+    bool init();
+    bool isOpen() const
+    {
+        return _device != 0;
+    }
+    const AudioFormat& format() const
+    {
+        return _format;
+    }
+
+    // Routes the player's audio into the input instead of libVLC's own output, before the player starts
+    void attach(libvlc_media_player_t* player, size_t input);
+    // The input to play, switched to once the current one is played out
+    void setActiveInput(size_t input);
+    // Drops what the input buffered of a stopped stream, call after stopping its player
+    void flush(size_t input);
+    // Where the input's next stream starts in its file, the file's silences if known and its normalization gain,
+    // before starting the player
+    void startStream(size_t input, int64_t positionMs, std::shared_ptr<const SilenceMap> silences, float gain);
+    // The input's player is about to jump in its file, applied with the flush libVLC sends for it
+    void seekStream(size_t input, int64_t positionMs);
+
+    void setSilenceSkip(bool enabled, int64_t maxPauseMs);
+    // Applies the streams' gains, or plays them as they are
+    void setNormalization(bool enabled);
+    // Playback speed, the pitch stays
+    void setSpeed(float speed);
+
+    // Stages aren't owned and must outlive the pipeline or be removed first
+    void addStage(AudioStage& stage);
+    void removeStage(AudioStage& stage);
+
+private:
+    static constexpr size_t kNoPosition = std::numeric_limits<size_t>::max();
+
+    struct Input
+    {
+        AudioPipeline*       owner {nullptr};
+        SpscRing<float>      ring;
+        std::atomic<bool>    paused {false};
+        std::atomic<size_t>  flushTo {kNoPosition};      // ring position up to which the consumer drops samples
+        std::atomic<size_t>  endPosition {kNoPosition};  // ring position where the stream drained
+        std::atomic<int64_t> seekTo {-1};                // ms, for the next flush
+
+        // the stream's position in its file, decoder thread once the player started
+        std::shared_ptr<const SilenceMap> silences;
+        float                             gain {1.f};
+        std::vector<float>                amplified;  // the samples with the gain applied
+        size_t                            silenceCursor {0};
+        int64_t                           streamFrame {0};
+        int64_t                           silentFrames {0};  // of the pause in progress
+        TimeStretcher                     stretcher;
+    };
+
+    // libVLC decoder threads
+    static void onPlay(void* data, const void* samples, unsigned count, int64_t pts);
+    static void onPause(void* data, int64_t pts);
+    static void onResume(void* data, int64_t pts);
+    static void onFlush(void* data, int64_t pts);
+    static void onDrain(void* data);
+
+    // SDL audio thread
+    static void onOutput(void* userData, uint8_t* stream, int length);
+    void        output(float* samples, size_t frames);
+    void        applyFlush(Input& input, bool isCurrent);
+
+    // Decoder thread, blocks while the ring is full
+    static void write(Input& input, const float* samples, size_t frames);
+    void        writeAtSpeed(Input& input, const float* samples, size_t frames);
+    size_t      framesToKeep(Input& input, const float* samples, size_t frames);
+    void        setStreamPosition(Input& input, int64_t positionMs);
+
+    uint32_t                       _device {0};
+    AudioFormat                    _format;
+    size_t                         _maxFrames {0};
+    size_t                         _silenceChunkFrames {0};
+    std::atomic<bool>              _skipSilence {false};
+    std::atomic<int64_t>           _maxPauseFrames {0};
+    std::atomic<bool>              _normalize {false};
+    std::atomic<float>             _speed {1.f};
+    std::array<Input, kInputCount> _inputs;
+    std::atomic<size_t>            _activeInput {0};
+    size_t                         _currentInput {0};  // audio thread only
+    std::vector<AudioStage*>       _stages;            // changed with the device locked
+};
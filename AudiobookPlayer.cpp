@@ -9,13 +9,40 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "uri.h"
+#include "ConcurrentQueue.h"
+#include "LibraryDatabase.h"
+#include "LibraryWatcher.h"
+#include "ThumbnailStore.h"
+#include "AudioPipeline.h"
+#include "BookChapters.h"
+#include "BookPlayback.h"
+#include "ChapterReader.h"
+#include "LoudnessMeter.h"
+#include "SilenceDetector.h"
+#include "TagReader.h"
+#include "Waveform.h"
 #include "Hq/StringHash.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <unordered_map>
 #include <unordered_set>
 #include <fstream>
+#include <future>
+#include <thread>
 #include <sstream>
 
 namespace fs = std::filesystem;
@@ -35,6 +62,12 @@ enum class PlayerState
     Player,
 };
 
+enum class LibraryView
+{
+    List,
+    Grid,
+};
+
 enum class TrackType
 {
     Unknown,
@@ -45,28 +78,96 @@ enum class TrackType
 
 // LITERALS
 
+// Covers
+static const std::string               kThumbnailDir           = "thumbnails";
+static const int                       kThumbnailSize          = 256;
+static const int                       kCoverAtlasSize         = 2048;
+static const int                       kCoverAtlasColumns      = kCoverAtlasSize / kThumbnailSize;
+static const int                       kCoverAtlasCells        = kCoverAtlasColumns * kCoverAtlasColumns;
+static const size_t                    kMaxCoverAtlasPages     = 4;
+static const size_t                    kMaxCachedCovers        = kMaxCoverAtlasPages * kCoverAtlasCells;
+static const size_t                    kCoverDecodeBatch       = 32;
+static const size_t                    kCoverUploadBudgetBytes = 8 * 1024 * 1024;
+static const std::chrono::microseconds kCoverUploadBudgetTime(2000);
+static const float                     kCoverGridCellSize      = 128.f;
+
 // Library db
 static const std::string kLibraryDb             = "library.db";
 static const std::string kInitialized           = "Initialized...";
 static const std::string kChooseLibraryLocation = "Choose Library Location";
-static const std::string kCreateBooksTable =
-    "create table if not exists books (key integer unique primary key, duration integer, author text, name text, series text, description text, path text, thumbnail_path)";
-static const std::string kCreateFilesTable =
-    "create table if not exists files (key integer unique primary key, book_id integer, last_modified integer, track_number integer, path text)";
-static const std::string kCreateBookmarksTable =
-    "create table if not exists bookmarks (key integer unique primary key, book_id integer, name text, file_id, position integer, description text)";
-static const std::string kCreateSettingsTable =
-    "create table if not exists settings (setting text unique primary key, value text)";
 static const std::string kLastBookMarkName = "##last##";
 
+// Media parsing
+static const uint32_t kMaxParsesInFlight = 16;
+static const int      kParseTimeoutMs    = 10000;
+
+// Library writes
+static const size_t                    kWriterBatchBooks = 256;
+static const std::chrono::milliseconds kWriterBatchTime(500);
+
+// Analysis
+static const unsigned kAnalysisMaxChannels    = 2;
+static const int64_t  kThrottledAnalysisSpeed = 8;  // times real time, while something plays
+
+// Silences
+static const int64_t kMinSilenceMs       = 250;  // shorter ones are never worth skipping
+static const int64_t kDefaultMaxPauseMs  = 700;
+static const float   kMinMaxPauseSeconds = 0.3f;
+static const float   kMaxMaxPauseSeconds = 3.f;
+
+// Loudness normalization
+static const double kTargetLoudness          = -18.;  // LUFS, ReplayGain 2 reference level
+static const double kMaxNormalizationGainDb  = 12.;
+static const double kMaxTruePeak             = -1.;  // dBTP
+
+// Speed
+static const float kMinSpeed     = 0.5f;
+static const float kMaxSpeed     = 3.f;
+static const float kDefaultSpeed = 1.f;
+static const float kSpeedSnap    = 0.03f;  // around the normal speed, which bypasses the stretcher
+
+// Scrubber
+static const float   kScrubberHeight    = 64.f;
+static const int64_t kMinScrubberSpanMs = 10000;  // zoomed in all the way
+static const float   kScrubberZoomStep  = 1.25f;  // per wheel notch
+
+// Chapters
+static const int64_t kChapterRestartMs = 3000;  // previous chapter goes back to the start of this one before that
+
+// Resume points
+static const std::chrono::seconds kCheckpointInterval(5);
+
+// Search
+static const size_t kMaxSearchResults = 500;
+
+// Redraw
+static const double kPlayingRedrawInterval   = 0.25;
+static const double kTextInputRedrawInterval = 0.5;
+
 // settings
-static const std::string kSettingLastBookId = "last_book_id";
-static const std::string kPlayingSpeed      = "playing_speed";
+static const std::string kSettingLastBookId  = "last_book_id";
+static const std::string kSettingLibraryPath = "library_path";
+static const std::string kSettingLibraryView = "library_view";
+static const std::string kLibraryViewList    = "list";
+static const std::string kLibraryViewGrid    = "grid";
+static const std::string kSettingAudioOutput = "audio_output";
+static const std::string kAudioOutputVlc     = "vlc";  // libVLC's own output, no sample processing
+static const std::string kSettingSkipSilence = "skip_silence";
+static const std::string kSettingMaxPauseMs  = "max_pause_ms";
+static const std::string kSettingNormalize   = "normalize_volume";
+static const std::string kSettingOn          = "on";
+static const std::string kPlayingSpeed      = "playing_speed";  // for books without a speed of their own
 
 // Extensions
 static const std::unordered_set<std::string> kIgnoreExtensions = {
     ".nfo", ".txt", ".pdf", ".epub", ".mobi", ".log", ".png", ".jpg", ".jpeg", ".gif", ".ico", ".bmp", ".tga"};
 static const std::unordered_set<std::string> kPlaylistExtensions = {".m3u"};
+static const std::unordered_set<std::string> kCoverExtensions    = {".jpg", ".jpeg", ".png"};
+
+// Covers
+// image names in a book's folder libVLC's local art finder used to pick, most preferred first, any case
+static const std::vector<std::string> kFolderCoverNames = {"folder", "albumartsmall", "albumart", "album",
+                                                           ".folder", "cover",         "thumb"};
 
 // Fonts
 
@@ -102,6 +203,11 @@ ImVec2 operator-(const ImVec2& lhs, const ImVec2& rhs)
     return ImVec2(lhs.x - rhs.x, lhs.y - rhs.y);
 }
 
+int64_t toMilliseconds(fs::file_time_type fileTime)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(fileTime.time_since_epoch()).count();
+}
+
 const char* ValueOrEmpty(const char* s)
 {
     return s == nullptr ? "" : s;
@@ -173,6 +279,15 @@ struct Texture
     float        aspectRatio {1};
 };
 
+// Part of a texture, covers share atlas pages
+struct TextureRegion
+{
+    unsigned int handle {0};
+    float        aspectRatio {1};
+    ImVec2       uv0 {0, 0};
+    ImVec2       uv1 {1, 1};
+};
+
 struct Track
 {
     TrackType type;
@@ -191,14 +306,16 @@ struct Meta
 
 struct Media
 {
-    uint32_t           id {0};
-    std::string        path;
-    int64_t            duration {0};
-    int64_t            lastModified;
-    uint32_t           trackNumber;
-    Meta               meta;
-    std::vector<Track> tracks;
-    bool               isPlaylist {false};
+    uint32_t             id {0};
+    std::string          path;
+    int64_t              duration {0};
+    int64_t              lastModified;
+    uint32_t             trackNumber;
+    Meta                 meta;
+    std::vector<Track>   tracks;
+    std::vector<Chapter> chapters;  // from the container, most formats have none
+    bool                 isPlaylist {false};
+    bool                 hasEmbeddedCover {false};  // seen by the tag reader, libVLC extracts it into artworkUrl
 
     bool isEmpty() const
     {
@@ -221,439 +338,2531 @@ struct Book
     uint64_t           duration {0};
     std::string        thumbnailLocation;
     std::vector<Media> files;
-    Texture            thumbnail;
 };
 
-struct Library
+void readTrackInfo(libvlc_media_track_t* track, Track& trackInfo)
 {
-    enum class State {
-        Idle,
-        Working
-    };
+    assert(track);
+    trackInfo.type = FromVLCTrackType(track->i_type);
+}
 
-    State                                _state {State::Idle};
-    sqlite3pp::database                  _libraryDb;
-    std::unique_ptr<enki::TaskScheduler> _taskScheduler;
-    std::unique_ptr<enki::TaskSet>       _currentTask;
-    libvlc_instance_t*                   _vlcInstance {nullptr};  // shared VLC instance with the player
-    std::vector<Book>                    _books;
-    Texture                              _genericCover;
+void readMediaInfo(libvlc_media_t* const media, Media& outInfo)
+{
+    libvlc_media_track_t** tracksInfo;
+    outInfo.duration = libvlc_media_get_duration(media);
 
-    Library()
-        : _taskScheduler(std::make_unique<enki::TaskScheduler>())
+    auto numTracks = libvlc_media_tracks_get(media, &tracksInfo);
+    for (auto i = 0u; i < numTracks; ++i)
     {
+        Track trackInfo;
+        readTrackInfo(tracksInfo[i], trackInfo);
+        outInfo.tracks.emplace_back(trackInfo);
     }
+    libvlc_media_tracks_release(tracksInfo, numTracks);
+}
 
-    ~Library()
+void readMediaMeta(libvlc_media_t* const media, Meta& outMeta)
+{
+    assert(media);
+    outMeta.author      = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Artist));
+    outMeta.name        = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Title));
+    outMeta.rating      = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Rating));
+    outMeta.artworkUrl  = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_ArtworkURL));
+    outMeta.publisher   = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Publisher));
+    outMeta.trackNumber = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_TrackNumber));
+    outMeta.description = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Description));
+}
+
+// https://stackoverflow.com/questions/18307429/encode-decode-url-in-c/35348028
+// https://www.codeguru.com/cpp/cpp/algorithms/strings/article.php/c12759/URI-Encoding-and-Decoding.htm
+std::string UriDecode(const std::string& sSrc)
+{
+    // Note from RFC1630: "Sequences which start with a percent
+    // sign but are not followed by two hexadecimal characters
+    // (0-9, A-F) are reserved for future extension"
+
+    const unsigned char*       pSrc    = (const unsigned char*)sSrc.c_str();
+    const int                  SRC_LEN = sSrc.length();
+    const unsigned char* const SRC_END = pSrc + SRC_LEN;
+    // last decodable '%'
+    const unsigned char* const SRC_LAST_DEC = SRC_END - 2;
+
+    char* const pStart = new char[SRC_LEN];
+    char*       pEnd   = pStart;
+
+    while (pSrc < SRC_LAST_DEC)
     {
-        _taskScheduler->WaitforAllAndShutdown();
-        _libraryDb.disconnect();
+        if (*pSrc == '%')
+        {
+            char dec1, dec2;
+            if (-1 != (dec1 = HEX2DEC[*(pSrc + 1)]) && -1 != (dec2 = HEX2DEC[*(pSrc + 2)]))
+            {
+                *pEnd++ = (dec1 << 4) + dec2;
+                pSrc += 3;
+                continue;
+            }
+        }
+
+        *pEnd++ = *pSrc++;
     }
 
-    bool isEmpty()
+    // the last 2- chars
+    while (pSrc < SRC_END)
+        *pEnd++ = *pSrc++;
+
+    std::string sResult(pStart, pEnd);
+    delete[] pStart;
+    return sResult;
+}
+
+// Cover locations are either plain paths or file:/// urls as reported by libVLC
+std::string imagePathFromLocation(const std::string& location)
+{
+    if (location.find("file:///") != std::string::npos)
     {
-        return _books.empty();
+        uri fileUri(location);
+        return UriDecode(fileUri.get_path());
     }
+    return location;
+}
 
-    bool init(libvlc_instance_t* vlcInstance)
-    {
-        _vlcInstance = vlcInstance;
-        _taskScheduler->Initialize();
+// The book folder's cover image, empty if it has none of the known names
+std::string findFolderCover(const std::string& folder)
+{
+    auto lowered = [](std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return text;
+    };
 
-        // Initialize database
-        _libraryDb.disconnect();
-        fs::path dbPath = fs::current_path();
-        dbPath.append(kLibraryDb);
-        int result = _libraryDb.connect(dbPath.string().c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
-        if (SQLITE_OK != result)
+    std::string     cover;
+    size_t          coverRank = kFolderCoverNames.size();
+    std::error_code errorCode;
+    for (fs::directory_iterator it(folder, errorCode); !errorCode && it != fs::directory_iterator();
+         it.increment(errorCode))
+    {
+        const fs::path& path = it->path();
+        if (kCoverExtensions.find(lowered(path.extension().string())) == kCoverExtensions.end())
         {
-            return false;
+            continue;
         }
-
-        result = _libraryDb.execute(kCreateBooksTable.c_str());
-        if (SQLITE_OK != result)
+        auto   nameIt = std::find(kFolderCoverNames.begin(), kFolderCoverNames.end(), lowered(path.stem().string()));
+        size_t rank   = size_t(nameIt - kFolderCoverNames.begin());
+        if (rank < coverRank)
         {
-            return false;
+            cover     = path.string();
+            coverRank = rank;
         }
-        result = _libraryDb.execute(kCreateFilesTable.c_str());
-        if (SQLITE_OK != result)
+    }
+    return cover;
+}
+
+// Full size decode, thread safe
+RgbaImage decodeImage(const std::string& location)
+{
+    RgbaImage image;
+    int       channels;
+    // always expanded to RGBA, grayscale covers exist and every upload stays 4 bytes aligned
+    std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(
+        stbi_load(imagePathFromLocation(location).c_str(), &image.width, &image.height, &channels, 4),
+        &stbi_image_free);
+    if (pixels)
+    {
+        image.pixels.assign(pixels.get(), pixels.get() + size_t(image.width) * image.height * 4);
+    }
+    return image;
+}
+
+// Must run on the thread owning the GL context
+Texture uploadImage(const RgbaImage& image)
+{
+    Texture texture;
+    if (!image.pixels.empty())
+    {
+        glGenTextures(1, &texture.handle);
+        glBindTexture(GL_TEXTURE_2D, texture.handle);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     image.pixels.data());
+
+        texture.aspectRatio = float(image.width) / image.height;
+    }
+    return texture;
+}
+
+// Keeps the covers of the books on screen. Thumbnails are loaded from the ThumbnailStore on the task scheduler's
+// workers in batches, the pixels come back through a queue and are uploaded by update() on the render thread, no
+// more than the per frame time and byte budget allows. Covers don't get a texture each, they are packed into
+// a few atlas pages cut into kThumbnailSize cells so a grid of covers draws from one texture. When the pages are
+// full the least recently drawn cover gives up its cell.
+class CoverCache
+{
+public:
+    CoverCache(enki::TaskScheduler& taskScheduler, const ThumbnailStore& thumbnails)
+        : _taskScheduler(taskScheduler)
+        , _thumbnails(thumbnails)
+    {
+    }
+
+    ~CoverCache()
+    {
+        if (_decodeTask)
         {
-            return false;
+            _taskScheduler.WaitforTask(_decodeTask.get());
         }
-        result = _libraryDb.execute(kCreateBookmarksTable.c_str());
-        if (SQLITE_OK != result)
+    }
+
+    void setFallback(const Texture& fallback)
+    {
+        _fallback.handle      = fallback.handle;
+        _fallback.aspectRatio = fallback.aspectRatio;
+    }
+
+    // Called while drawing, returns the fallback until the cover is ready
+    const TextureRegion& get(uint32_t bookId, const std::string& location)
+    {
+        auto entryIt = _entries.find(bookId);
+        if (entryIt != _entries.end() && entryIt->second.location == location)
         {
-            return false;
+            Entry& entry  = entryIt->second;
+            entry.lastUse = _frame;
+            return entry.slot >= 0 ? entry.region : _fallback;
         }
-        result = _libraryDb.execute(kCreateSettingsTable.c_str());
-        if (SQLITE_OK != result)
+
+        Entry& entry = _entries[bookId];
+        releaseSlot(entry);
+        entry.location = location;
+        entry.lastUse  = _frame;
+        entry.pending  = !location.empty();
+        if (entry.pending)
         {
-            return false;
+            _requests.push_back({bookId, location});
         }
+        return _fallback;
+    }
 
-        _genericCover = loadImage("generic_cover.png");
-        if (!_genericCover.handle)
+    // True while covers are being loaded or uploaded, update() has to keep running every frame
+    bool needsUpdate() const
+    {
+        return !_requests.empty() || !_decoded.empty() || (_decodeTask && !_decodeTask->GetIsComplete());
+    }
+
+    // Render thread, once per frame before drawing
+    void update()
+    {
+        evict();
+        ++_frame;
+        uploadDecoded();
+
+        if ((!_decodeTask || _decodeTask->GetIsComplete()) && !_requests.empty())
         {
-            return false;
+            // newest requests first, they are the ones currently on screen
+            size_t batchSize = std::min(_requests.size(), kCoverDecodeBatch);
+            _decodeBatch.assign(_requests.end() - batchSize, _requests.end());
+            _requests.erase(_requests.end() - batchSize, _requests.end());
+
+            _decodeTask = std::make_unique<enki::TaskSet>(
+                uint32_t(_decodeBatch.size()), [this](enki::TaskSetPartition range, uint32_t threadnum) {
+                    for (uint32_t i = range.start; i < range.end; ++i)
+                    {
+                        Decoded decoded;
+                        decoded.bookId   = _decodeBatch[i].bookId;
+                        decoded.location = _decodeBatch[i].location;
+                        _thumbnails.load(imagePathFromLocation(decoded.location), decoded.image);
+                        _decoded.push(std::move(decoded));
+                    }
+                });
+            _taskScheduler.AddTaskSetToPipe(_decodeTask.get());
         }
+    }
 
-        readLibraryFromDb();
+private:
+    struct Request
+    {
+        uint32_t    bookId;
+        std::string location;
+    };
 
-        return true;
+    struct Decoded
+    {
+        uint32_t    bookId {0};
+        std::string location;
+        RgbaImage   image;
+    };
+
+    struct Entry
+    {
+        TextureRegion region;
+        int           slot {-1};  // atlas cell, page * kCoverAtlasCells + cell
+        std::string   location;
+        uint64_t      lastUse {0};
+        bool          pending {false};
+    };
+
+    bool isOnScreen(const Entry& entry) const
+    {
+        // drawn during the previous frame
+        return entry.lastUse + 1 >= _frame;
     }
 
-    bool startLibraryDiscovery(const std::string& pathName)
+    void uploadDecoded()
     {
-        _currentTask = std::make_unique<enki::TaskSet>([pathName, this](enki::TaskSetPartition range,
-                                                                        uint32_t               threadnum) {
-            fs::path path(pathName);
-            if (!fs::exists(path) || !fs::is_directory(path))
+        using Clock = std::chrono::steady_clock;
+        auto    deadline = Clock::now() + kCoverUploadBudgetTime;
+        size_t  bytes    = 0;
+        Decoded decoded;
+        while (bytes < kCoverUploadBudgetBytes && Clock::now() < deadline && _decoded.tryPop(decoded))
+        {
+            auto entryIt = _entries.find(decoded.bookId);
+            if (entryIt == _entries.end() || entryIt->second.location != decoded.location)
             {
-                return;
+                // evicted or changed while decoding
+                continue;
             }
 
-            _books.clear();
-            fs::recursive_directory_iterator rdi(path);
-            bool                             wasPreviousDirectory = false;
-            for (const auto& entry : rdi)
+            Entry& entry  = entryIt->second;
+            entry.pending = false;
+            if (decoded.image.pixels.empty() || decoded.image.width > kThumbnailSize ||
+                decoded.image.height > kThumbnailSize)
             {
-                std::cout << entry.path() << '\n';
-                if (entry.is_directory())
-                {
-                    if (wasPreviousDirectory && !_books.empty())
-                    {
-                        _books.pop_back();
-                    }
-                    wasPreviousDirectory = true;
-                    Book newBook;
-                    newBook.name   = entry.path().filename().string();
-                    newBook.folder = entry.path().string();
-                    _books.emplace_back(newBook);
-                }
-                else if (entry.is_regular_file())
-                {
-                    wasPreviousDirectory = false;
-                    if (kIgnoreExtensions.find(entry.path().extension().string()) != kIgnoreExtensions.end())
-                    {
-                        // skip this file
-                        continue;
-                    }
+                // no usable cover, the fallback stays
+                continue;
+            }
 
-                    libvlc_media_t* media = libvlc_media_new_path(_vlcInstance, entry.path().string().c_str());
-                    if (!media)
-                    {
-                        // couldn't load media, skip
-                        continue;
-                    }
+            int slot = allocateSlot();
+            if (slot < 0)
+            {
+                // every cell is on screen, requested again the next time it's drawn
+                _entries.erase(entryIt);
+                continue;
+            }
 
-                    libvlc_media_parse(media);
+            int page = slot / kCoverAtlasCells;
+            int x    = (slot % kCoverAtlasCells) % kCoverAtlasColumns * kThumbnailSize;
+            int y    = (slot % kCoverAtlasCells) / kCoverAtlasColumns * kThumbnailSize;
+            glBindTexture(GL_TEXTURE_2D, _atlasPages[page]);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, decoded.image.width, decoded.image.height, GL_RGBA,
+                            GL_UNSIGNED_BYTE, decoded.image.pixels.data());
+
+            // inset by half a texel, linear filtering must not pick up the neighbouring cell
+            const float texel        = 1.f / kCoverAtlasSize;
+            entry.slot               = slot;
+            entry.region.handle      = _atlasPages[page];
+            entry.region.aspectRatio = float(decoded.image.width) / decoded.image.height;
+            entry.region.uv0         = ImVec2((x + 0.5f) * texel, (y + 0.5f) * texel);
+            entry.region.uv1 =
+                ImVec2((x + decoded.image.width - 0.5f) * texel, (y + decoded.image.height - 0.5f) * texel);
+            bytes += decoded.image.pixels.size();
+        }
+    }
 
-                    if (!_books.empty())
-                    {
-                        Book& lastBook = _books.back();
-                        Media mediaInfo;
-                        mediaInfo.path = entry.path().string();
-                        if (kPlaylistExtensions.find(entry.path().extension().string()) != kPlaylistExtensions.end())
-                        {
-                            mediaInfo.isPlaylist = true;
-                        }
-                        auto lastModifiedTime = fs::last_write_time(entry.path());
-
-                        mediaInfo.lastModified =
-                            std::chrono::duration_cast<std::chrono::milliseconds>(lastModifiedTime.time_since_epoch())
-                                .count();
-                        readMediaInfo(media, mediaInfo);
-                        readMediaMeta(media, mediaInfo.meta);
-                        lastBook.files.emplace_back(mediaInfo);
-                    }
+    int allocateSlot()
+    {
+        if (_freeSlots.empty() && _atlasPages.size() < kMaxCoverAtlasPages)
+        {
+            unsigned int page;
+            glGenTextures(1, &page);
+            glBindTexture(GL_TEXTURE_2D, page);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, kCoverAtlasSize, kCoverAtlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         nullptr);
 
-                    libvlc_media_release(media);
-                }
+            int firstSlot = int(_atlasPages.size()) * kCoverAtlasCells;
+            _atlasPages.push_back(page);
+            for (int slot = firstSlot + kCoverAtlasCells - 1; slot >= firstSlot; --slot)
+            {
+                _freeSlots.push_back(slot);
             }
+        }
 
-            for (auto& book : _books)
+        if (_freeSlots.empty())
+        {
+            // take the cell of the least recently drawn cover
+            auto oldest = _entries.end();
+            for (auto it = _entries.begin(); it != _entries.end(); ++it)
             {
-                // make sure not empty
-                if (book.files.size())
+                if (it->second.slot >= 0 && !isOnScreen(it->second) &&
+                    (oldest == _entries.end() || it->second.lastUse < oldest->second.lastUse))
                 {
-                    resolveBookInfo(book);
-                    writeBookToDb(book);
+                    oldest = it;
                 }
             }
-            _state = State::Idle;
-        });
-        _taskScheduler->AddTaskSetToPipe(_currentTask.get());
-        _state = State::Working;
+            if (oldest == _entries.end())
+            {
+                return -1;
+            }
+            releaseSlot(oldest->second);
+            _entries.erase(oldest);
+        }
 
-        return true;
+        int slot = _freeSlots.back();
+        _freeSlots.pop_back();
+        return slot;
     }
 
-    void readMediaInfo(libvlc_media_t* const media, Media& outInfo) const
+    void evict()
     {
-        libvlc_media_track_t** tracksInfo;
-        outInfo.duration = libvlc_media_get_duration(media);
-
-        auto numTracks = libvlc_media_tracks_get(media, &tracksInfo);
-        for (auto i = 0u; i < numTracks; ++i)
+        while (_entries.size() > kMaxCachedCovers)
         {
-            Track trackInfo;
-            readTrackInfo(tracksInfo[i], trackInfo);
-            outInfo.tracks.emplace_back(trackInfo);
+            auto oldest = std::min_element(_entries.begin(), _entries.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.second.lastUse < rhs.second.lastUse;
+            });
+            if (oldest->second.lastUse == _frame)
+            {
+                // everything is on screen
+                break;
+            }
+            releaseSlot(oldest->second);
+            _entries.erase(oldest);
         }
-        libvlc_media_tracks_release(tracksInfo, numTracks);
     }
 
-    void readMediaMeta(libvlc_media_t* const media, Meta& outMeta) const
+    void releaseSlot(Entry& entry)
     {
-        assert(media);
-        outMeta.author      = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Artist));
-        outMeta.name        = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Title));
-        outMeta.rating      = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Rating));
-        outMeta.artworkUrl  = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_ArtworkURL));
-        outMeta.publisher   = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Publisher));
-        outMeta.trackNumber = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_TrackNumber));
-        outMeta.description = ValueOrEmpty(libvlc_media_get_meta(media, libvlc_meta_Description));
+        if (entry.slot >= 0)
+        {
+            _freeSlots.push_back(entry.slot);
+        }
+        entry.slot   = -1;
+        entry.region = TextureRegion();
     }
 
-    void readTrackInfo(libvlc_media_track_t* track, Track& trackInfo) const
-    {
-        assert(track);
-        trackInfo.type = FromVLCTrackType(track->i_type);
-    }
+    enki::TaskScheduler&                  _taskScheduler;
+    const ThumbnailStore&                 _thumbnails;
+    std::unique_ptr<enki::TaskSet>        _decodeTask;
+    std::vector<Request>                  _decodeBatch;  // owned by _decodeTask while it runs
+    std::vector<Request>                  _requests;
+    ConcurrentQueue<Decoded>              _decoded;
+    std::unordered_map<uint32_t, Entry>   _entries;
+    std::vector<unsigned int>             _atlasPages;
+    std::vector<int>                      _freeSlots;
+    TextureRegion                         _fallback;
+    uint64_t                              _frame {0};
+};
 
-    void resolveBookInfo(Book& book)
+// Runs libVLC parsing asynchronously. At most maxInFlight requests are pending at any time, each one bounded by a
+// timeout, so a slow or corrupt file only occupies one slot instead of stalling the whole scan. Every submitted file
+// produces exactly one completion, failed ones included. Formats the tag reader knows skip libVLC, their headers are
+// read on the submitting thread and they complete right away.
+class MediaParser
+{
+public:
+    struct Completion
     {
+        uint64_t cookie {0};
+        bool     parsed {false};
+        Media    media;
+    };
 
-        if (!book.name.empty() && book.files.size() > 1)
+    ~MediaParser()
+    {
+        // callbacks reference this object, let the pending ones land before going away
         {
-            if (book.files[0].meta.name == book.files[1].meta.name)
-            {
-                book.name = book.files[0].meta.name;
-            }
+            std::unique_lock<std::mutex> lock(_slotsMutex);
+            _slotsCondition.wait(lock, [this]() { return _inFlight == 0; });
         }
-
-        // try get the name from meta info
-        if (book.name.empty())
+        Completion completion;
+        while (tryPopCompleted(completion))
         {
-            for (const auto& file : book.files)
-            {
-                if (!file.meta.name.empty())
-                {
-                    book.name = file.meta.name;
-                    break;
-                }
-            }
         }
+    }
 
-        // try get author from meta
-        if (book.author.empty())
+    void init(libvlc_instance_t* vlcInstance, uint32_t maxInFlight, int timeoutMs)
+    {
+        _vlcInstance = vlcInstance;
+        _maxInFlight = std::max(maxInFlight, 1u);
+        _timeoutMs   = timeoutMs;
+    }
+
+    // Blocks while the maximum number of parses is in flight. Parsing for the artwork only goes through libVLC even if
+    // the tag reader knows the format, libVLC is what extracts embedded covers; chapters aren't read then.
+    void submit(const fs::path& filePath, int64_t lastModified, uint64_t cookie, bool artworkOnly = false)
+    {
+        assert(_vlcInstance);
+        auto request    = std::make_unique<Request>();
+        request->parser = this;
+        request->cookie = cookie;
+
+        Media& info = request->info;
+        info.path   = filePath.string();
+        if (kPlaylistExtensions.find(filePath.extension().string()) != kPlaylistExtensions.end())
         {
-            for (const auto& file : book.files)
-            {
-                if (!file.meta.author.empty())
-                {
-                    book.author = file.meta.author;
-                    break;
-                }
-            }
+            info.isPlaylist = true;
         }
+        info.lastModified = lastModified;
 
-        // if not found in meta, get name from folder name
-        if (book.name.empty())
+        AudioTags tags;
+        if (!artworkOnly && !info.isPlaylist && readAudioTags(info.path, tags))
         {
-            fs::path bookFolder(book.folder);
-            book.name = bookFolder.filename().string();
+            info.duration         = tags.duration;
+            info.meta.author      = std::move(tags.artist);
+            info.meta.name        = std::move(tags.title);
+            info.meta.publisher   = std::move(tags.publisher);
+            info.meta.trackNumber = std::move(tags.trackNumber);
+            info.meta.description = std::move(tags.description);
+            info.hasEmbeddedCover = tags.hasPicture;
+            info.chapters         = std::move(tags.chapters);
+            info.tracks.push_back({TrackType::Audio});
+            request->parsed = true;
+            _finished.push(std::move(request));
+            return;
         }
 
-        // try retrieving artwork from meta
-        if (book.thumbnailLocation.empty())
+        request->readChapters = !artworkOnly;
+        request->media        = libvlc_media_new_path(_vlcInstance, info.path.c_str());
+        if (!request->media)
         {
-            for (const auto& file : book.files)
-            {
-                if (!file.meta.artworkUrl.empty())
-                {
-                    book.thumbnailLocation = file.meta.artworkUrl;
-                    break;
-                }
-            }
+            // couldn't load media, report it as failed right away
+            _finished.push(std::move(request));
+            return;
         }
 
-        // if not found in meta info try looking for an image inside folder
-        if (book.thumbnailLocation.empty())
         {
+            std::unique_lock<std::mutex> lock(_slotsMutex);
+            _slotsCondition.wait(lock, [this]() { return _inFlight < _maxInFlight; });
+            ++_inFlight;
         }
 
-        for (const auto& file : book.files)
+        Request*                  pendingRequest = request.release();
+        libvlc_event_manager_t*   eventManager   = libvlc_media_event_manager(pendingRequest->media);
+        libvlc_media_parse_flag_t parseFlags =
+            libvlc_media_parse_flag_t(libvlc_media_parse_local | libvlc_media_fetch_local);
+        libvlc_event_attach(eventManager, libvlc_MediaParsedChanged, &MediaParser::onParsedChanged, pendingRequest);
+        if (libvlc_media_parse_with_options(pendingRequest->media, parseFlags, _timeoutMs) != 0)
         {
-            book.duration += file.duration;
+            libvlc_event_detach(eventManager, libvlc_MediaParsedChanged, &MediaParser::onParsedChanged,
+                                pendingRequest);
+            finishRequest(std::unique_ptr<Request>(pendingRequest));
         }
     }
 
-    // https://stackoverflow.com/questions/18307429/encode-decode-url-in-c/35348028
-    // https://www.codeguru.com/cpp/cpp/algorithms/strings/article.php/c12759/URI-Encoding-and-Decoding.htm
-    std::string UriDecode(const std::string& sSrc)
+    bool tryPopCompleted(Completion& outCompletion)
     {
-        // Note from RFC1630: "Sequences which start with a percent
-        // sign but are not followed by two hexadecimal characters
-        // (0-9, A-F) are reserved for future extension"
+        std::unique_ptr<Request> request;
+        if (!_finished.tryPop(request))
+        {
+            return false;
+        }
+        complete(std::move(request), outCompletion);
+        return true;
+    }
 
-        const unsigned char*       pSrc    = (const unsigned char*)sSrc.c_str();
-        const int                  SRC_LEN = sSrc.length();
-        const unsigned char* const SRC_END = pSrc + SRC_LEN;
-        // last decodable '%'
-        const unsigned char* const SRC_LAST_DEC = SRC_END - 2;
+    void waitCompleted(Completion& outCompletion)
+    {
+        std::unique_ptr<Request> request;
+        _finished.waitPop(request);
+        complete(std::move(request), outCompletion);
+    }
 
-        char* const pStart = new char[SRC_LEN];
-        char*       pEnd   = pStart;
+private:
+    struct Request
+    {
+        MediaParser*    parser {nullptr};
+        libvlc_media_t* media {nullptr};
+        uint64_t        cookie {0};
+        bool            parsed {false};
+        bool            readChapters {false};  // after a libVLC parse
+        Media           info;
+    };
 
-        while (pSrc < SRC_LAST_DEC)
+    // Called from a libVLC thread
+    static void onParsedChanged(const libvlc_event_t* event, void* userData)
+    {
+        Request* request = static_cast<Request*>(userData);
+        if (event->u.media_parsed_changed.new_status == libvlc_media_parsed_status_done)
         {
-            if (*pSrc == '%')
-            {
-                char dec1, dec2;
-                if (-1 != (dec1 = HEX2DEC[*(pSrc + 1)]) && -1 != (dec2 = HEX2DEC[*(pSrc + 2)]))
-                {
-                    *pEnd++ = (dec1 << 4) + dec2;
-                    pSrc += 3;
-                    continue;
-                }
-            }
-
-            *pEnd++ = *pSrc++;
+            readMediaInfo(request->media, request->info);
+            readMediaMeta(request->media, request->info.meta);
+            request->parsed = true;
         }
+        request->parser->finishRequest(std::unique_ptr<Request>(request));
+    }
 
-        // the last 2- chars
-        while (pSrc < SRC_END)
-            *pEnd++ = *pSrc++;
-
-        std::string sResult(pStart, pEnd);
-        delete[] pStart;
-        return sResult;
+    void finishRequest(std::unique_ptr<Request>&& request)
+    {
+        _finished.push(std::move(request));
+        {
+            std::lock_guard<std::mutex> lock(_slotsMutex);
+            --_inFlight;
+        }
+        _slotsCondition.notify_all();
     }
 
-    Texture loadImage(const std::string& filename)
+    // Runs on the consumer side, never inside a libVLC callback, so releasing the media is safe here
+    void complete(std::unique_ptr<Request>&& request, Completion& outCompletion)
     {
-        Texture     texture;
-        std::string path;
-        if (filename.find("file:///") != std::string::npos)
+        if (request->media)
         {
-            uri fileUri(filename);
-            path = UriDecode(fileUri.get_path());
+            libvlc_event_detach(libvlc_media_event_manager(request->media), libvlc_MediaParsedChanged,
+                                &MediaParser::onParsedChanged, request.get());
+            libvlc_media_release(request->media);
         }
-        else
+        outCompletion.cookie = request->cookie;
+        outCompletion.parsed = request->parsed;
+        outCompletion.media  = std::move(request->info);
+        if (outCompletion.parsed && request->readChapters)
         {
-            path = filename;
+            // libVLC's parse doesn't report chapters, they come from the container itself
+            outCompletion.media.chapters = readChapters(outCompletion.media.path);
         }
+    }
 
-        int width, height, channels;
+    libvlc_instance_t*                        _vlcInstance {nullptr};
+    uint32_t                                  _maxInFlight {1};
+    int                                       _timeoutMs {-1};
+    uint32_t                                  _inFlight {0};
+    std::mutex                                _slotsMutex;
+    std::condition_variable                   _slotsCondition;
+    ConcurrentQueue<std::unique_ptr<Request>> _finished;
+};
 
-        unsigned char* imageData = stbi_load(path.c_str(), &width, &height, &channels, 0);
+// What the analyzer measured of one file
+struct FileAnalysis
+{
+    SilenceMap            silences;
+    std::optional<double> loudness;  // LUFS, null for silent files
+    std::optional<double> truePeak;  // dBTP
+    Waveform              waveform;
+    bool                  failed {false};  // couldn't be decoded, playback finds its silences live
+};
+
+// Owns a thread doing all library writes. Jobs are committed in batches, every kWriterBatchBooks books or
+// kWriterBatchTime, whichever comes first, using statements prepared once for the thread's lifetime.
+// Each book is wrapped in a savepoint so a failing one doesn't take the rest of the batch with it. Books and
+// removals are published to the given queues only after their batch is committed.
+class LibraryWriter
+{
+public:
+    LibraryWriter(sqlite3pp::database& db, ConcurrentQueue<Book>& writtenBooks, ConcurrentQueue<uint32_t>& removedBookIds)
+        : _db(db)
+        , _writtenBooks(writtenBooks)
+        , _removedBookIds(removedBookIds)
+    {
+    }
+
+    ~LibraryWriter()
+    {
+        stop();
+    }
+
+    // Called on the writer thread after committed changes were published, must be set before start()
+    void setPublishedCallback(std::function<void()> published)
+    {
+        _published = std::move(published);
+    }
+
+    void start(size_t batchBooks, std::chrono::milliseconds batchTime)
+    {
+        stop();
+        _batchBooks = std::max<size_t>(batchBooks, 1);
+        _batchTime  = batchTime;
+        _thread     = std::thread([this]() { run(); });
+    }
+
+    void stop()
+    {
+        if (_thread.joinable())
+        {
+            Job job;
+            job.type = Job::Type::Stop;
+            _jobs.push(std::move(job));
+            _thread.join();
+        }
+    }
+
+    void writeBook(Book&& book)
+    {
+        Job job;
+        job.type = Job::Type::WriteBook;
+        job.book = std::move(book);
+        _jobs.push(std::move(job));
+    }
+
+    void removeBook(uint32_t bookId)
+    {
+        Job job;
+        job.type   = Job::Type::RemoveBook;
+        job.bookId = bookId;
+        _jobs.push(std::move(job));
+    }
+
+    void clear()
+    {
+        Job job;
+        job.type = Job::Type::Clear;
+        _jobs.push(std::move(job));
+    }
+
+    // Replaces the folder's files that didn't parse, (path, last modified) pairs
+    void writeSkippedFiles(const std::string& folder, std::vector<std::pair<std::string, int64_t>>&& files)
+    {
+        Job job;
+        job.type         = Job::Type::WriteSkippedFiles;
+        job.key          = folder;
+        job.skippedFiles = std::move(files);
+        _jobs.push(std::move(job));
+    }
+
+    void writeSetting(const std::string& setting, const std::string& value)
+    {
+        Job job;
+        job.type = Job::Type::WriteSetting;
+        job.key  = setting;
+        job.text = value;
+        _jobs.push(std::move(job));
+    }
+
+    // Upserts the book's resume point. Checkpoints coalesce, if the writer hasn't got to the previous one yet it is
+    // replaced and only the latest position is written.
+    void writeCheckpoint(uint32_t bookId, const std::string& filePath, int64_t position)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_checkpointMutex);
+            bool                        queued = _checkpoint.has_value();
+            _checkpoint                        = Checkpoint {bookId, filePath, position};
+            if (queued)
+            {
+                return;
+            }
+        }
+        Job job;
+        job.type = Job::Type::WriteCheckpoint;
+        _jobs.push(std::move(job));
+    }
+
+    // Chapters of a file stored before they were read, replaces any it has
+    void writeChapters(int64_t fileId, std::vector<Chapter>&& chapters)
+    {
+        Job job;
+        job.type     = Job::Type::WriteChapters;
+        job.fileId   = fileId;
+        job.chapters = std::move(chapters);
+        _jobs.push(std::move(job));
+    }
+
+    void writeBookSpeed(uint32_t bookId, float speed)
+    {
+        Job job;
+        job.type   = Job::Type::WriteBookSpeed;
+        job.bookId = bookId;
+        job.speed  = speed;
+        _jobs.push(std::move(job));
+    }
+
+    // Marked failed if the file couldn't be analyzed
+    void writeAnalysis(int64_t fileId, FileAnalysis&& analysis)
+    {
+        Job job;
+        job.type     = Job::Type::WriteAnalysis;
+        job.fileId   = fileId;
+        job.analysis = std::move(analysis);
+        _jobs.push(std::move(job));
+    }
+
+    void execute(const std::string& sql)
+    {
+        Job job;
+        job.type = Job::Type::Execute;
+        job.text = sql;
+        _jobs.push(std::move(job));
+    }
+
+    // Blocks until every job queued so far is committed and published
+    void flush()
+    {
+        std::promise<void> flushed;
+        Job                job;
+        job.type    = Job::Type::Flush;
+        job.flushed = &flushed;
+        _jobs.push(std::move(job));
+        flushed.get_future().wait();
+    }
+
+private:
+    struct Checkpoint
+    {
+        uint32_t    bookId {0};
+        std::string filePath;
+        int64_t     position {0};  // inside the file
+    };
+
+    struct Job
+    {
+        enum class Type
+        {
+            WriteBook,
+            RemoveBook,
+            Clear,
+            WriteSkippedFiles,
+            WriteSetting,
+            WriteCheckpoint,
+            WriteAnalysis,
+            WriteChapters,
+            WriteBookSpeed,
+            Execute,
+            Flush,
+            Stop
+        };
+
+        Type                                         type {Type::Flush};
+        Book                                         book;
+        FileAnalysis                                 analysis;
+        std::vector<Chapter>                         chapters;
+        std::vector<std::pair<std::string, int64_t>> skippedFiles;
+        uint32_t                                     bookId {0};
+        int64_t                                      fileId {0};
+        float                                        speed {0.f};
+        std::string                                  key;
+        std::string                                  text;
+        std::promise<void>*                          flushed {nullptr};
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    void run()
+    {
+        sqlite3pp::command insertBook(
+            _db,
+            "insert into books (duration, author, name, series, description, path, thumbnail_path) values (?, ?, ?, ?, ?, ?, ?)");
+        sqlite3pp::command updateBook(
+            _db,
+            "update books set duration = ?, author = ?, name = ?, series = ?, description = ?, path = ?, thumbnail_path = ? where key = ?");
+        // files are matched by path and keep their key, bookmarks and analyses refer to it
+        sqlite3pp::query   findFile(_db, "select key, last_modified from files where path = ?");
+        sqlite3pp::query   findBookFiles(_db, "select key from files where book_id = ?");
+        sqlite3pp::command insertFile(
+            _db, "insert into files (book_id, last_modified, track_number, path, duration) values (?, ?, ?, ?, ?)");
+        sqlite3pp::command updateFile(
+            _db,
+            "update files set book_id = ?, last_modified = ?, track_number = ?, duration = ?, chapters_pending = 0 where key = ?");
+        sqlite3pp::command resetLoudness(_db, "update files set loudness = null, true_peak = null where key = ?");
+        sqlite3pp::command deleteSilences(_db, "delete from silences where file_id = ?");
+        sqlite3pp::command deleteWaveform(_db, "delete from waveforms where file_id = ?");
+        sqlite3pp::command insertChapter(_db, "insert into chapters (file_id, start, title) values (?, ?, ?)");
+        sqlite3pp::command deleteChapters(_db, "delete from chapters where file_id = ?");
+        sqlite3pp::command clearChaptersPending(_db, "update files set chapters_pending = 0 where key = ?");
+        sqlite3pp::command deleteFile(_db, "delete from files where key = ?");
+        sqlite3pp::command deleteFiles(_db, "delete from files where book_id = ?");
+        sqlite3pp::command deleteBookmarks(_db, "delete from bookmarks where book_id = ?");
+        sqlite3pp::command writeCheckpoint(
+            _db, "insert into bookmarks (book_id, name, file_id, position) values (?, ?, (select key from files where path = ?), ?) "
+                 "on conflict (book_id, name) do update set file_id = excluded.file_id, position = excluded.position");
+        sqlite3pp::command writeSilences(_db,
+                                         "insert or replace into silences (file_id, ranges, failed) values (?, ?, ?)");
+        sqlite3pp::command writeLoudness(_db, "update files set loudness = ?, true_peak = ? where key = ?");
+        sqlite3pp::command writeWaveform(_db, "insert or replace into waveforms (file_id, peaks) values (?, ?)");
+        sqlite3pp::command writeBookSpeed(_db, "update books set speed = ? where key = ?");
+        sqlite3pp::command deleteBook(_db, "delete from books where key = ?");
+        sqlite3pp::command deleteSkippedFiles(_db, "delete from skipped_files where folder = ?");
+        sqlite3pp::command insertSkippedFile(
+            _db, "insert or replace into skipped_files (path, folder, last_modified) values (?, ?, ?)");
+        sqlite3pp::command writeSetting(_db, "insert or replace into settings (setting, value) values (?, ?)");
+
+        auto execute = [](sqlite3pp::command& cmd, auto&&... values) -> bool {
+            cmd.reset();
+            auto binder = cmd.binder();
+            (void)std::initializer_list<int> {((void)(binder << values), 0)...};
+            return SQLITE_OK == cmd.execute();
+        };
+
+        auto writeChapters = [&](int64_t fileId, const std::vector<Chapter>& chapters) -> bool {
+            if (!execute(deleteChapters, fileId))
+            {
+                return false;
+            }
+            for (const auto& chapter : chapters)
+            {
+                if (!execute(insertChapter, fileId, chapter.start, chapter.title))
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        auto writeBook = [&](Book& bookInfo) -> bool {
+            int64_t bookId = bookInfo.id;
+            if (bookId)
+            {
+                // already stored book, update in place
+                if (!execute(updateBook, int64_t(bookInfo.duration), bookInfo.author, bookInfo.name, bookInfo.series,
+                             bookInfo.description, bookInfo.folder, bookInfo.thumbnailLocation, bookId))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                if (!execute(insertBook, int64_t(bookInfo.duration), bookInfo.author, bookInfo.name, bookInfo.series,
+                             bookInfo.description, bookInfo.folder, bookInfo.thumbnailLocation))
+                {
+                    return false;
+                }
+                bookId      = _db.last_insert_rowid();
+                bookInfo.id = uint32_t(bookId);
+            }
+
+            std::unordered_set<int64_t> fileIds;
+            for (const auto& media : bookInfo.files)
+            {
+                std::optional<int64_t> fileId;
+                int64_t                lastModified = 0;
+                findFile.reset();
+                findFile.bind(1, media.path, sqlite3pp::nocopy);
+                for (auto row : findFile)
+                {
+                    fileId       = row.get<long long>(0);
+                    lastModified = row.get<long long>(1);
+                }
+
+                int trackNumber = std::atoi(media.meta.trackNumber.c_str());
+                if (!fileId)
+                {
+                    if (!execute(insertFile, bookId, media.lastModified, trackNumber, media.path, media.duration))
+                    {
+                        return false;
+                    }
+                    fileId = _db.last_insert_rowid();
+                }
+                else
+                {
+                    // chapters are replaced below, the analysis only if the content changed
+                    bool modified = lastModified != media.lastModified;
+                    if (!execute(updateFile, bookId, media.lastModified, trackNumber, media.duration, *fileId) ||
+                        (modified && (!execute(resetLoudness, *fileId) || !execute(deleteSilences, *fileId) ||
+                                      !execute(deleteWaveform, *fileId))))
+                    {
+                        return false;
+                    }
+                }
+
+                fileIds.insert(*fileId);
+                if (!writeChapters(*fileId, media.chapters))
+                {
+                    return false;
+                }
+            }
+
+            // files gone from the folder
+            std::vector<int64_t> removedFileIds;
+            findBookFiles.reset();
+            findBookFiles.bind(1, (long long)bookId);
+            for (auto row : findBookFiles)
+            {
+                int64_t fileId = row.get<long long>(0);
+                if (fileIds.find(fileId) == fileIds.end())
+                {
+                    removedFileIds.push_back(fileId);
+                }
+            }
+            for (int64_t fileId : removedFileIds)
+            {
+                if (!execute(deleteFile, fileId))
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        // blobs, not text, bound without the binder, null when empty
+        auto writeFileBlob = [](sqlite3pp::command& cmd, int64_t fileId, const std::string& blob) -> bool {
+            cmd.reset();
+            cmd.bind(1, (long long)fileId);
+            if (blob.empty())
+            {
+                cmd.bind(2);
+            }
+            else
+            {
+                cmd.bind(2, blob.data(), int(blob.size()), sqlite3pp::nocopy);
+            }
+            return SQLITE_OK == cmd.execute();
+        };
+
+        // the measurements may be null, bound without the binder as well
+        auto writeFileAnalysis = [&](int64_t fileId, const FileAnalysis& analysis) -> bool {
+            std::string waveform = analysis.waveform.empty() ? std::string() : analysis.waveform.encode();
+            // bound ahead, resetting the statement keeps it
+            writeSilences.reset();
+            writeSilences.bind(3, analysis.failed ? 1 : 0);
+            if (!writeFileBlob(writeSilences, fileId, encodeSilenceMap(analysis.silences)) ||
+                !writeFileBlob(writeWaveform, fileId, waveform))
+            {
+                return false;
+            }
+
+            writeLoudness.reset();
+            int index = 1;
+            for (const auto& value : {analysis.loudness, analysis.truePeak})
+            {
+                if (value)
+                {
+                    writeLoudness.bind(index++, *value);
+                }
+                else
+                {
+                    writeLoudness.bind(index++);
+                }
+            }
+            writeLoudness.bind(index, (long long)fileId);
+            return SQLITE_OK == writeLoudness.execute();
+        };
+
+        auto removeBook = [&](int64_t bookId) -> bool {
+            return execute(deleteBookmarks, bookId) && execute(deleteFiles, bookId) && execute(deleteBook, bookId);
+        };
+
+        std::unique_ptr<sqlite3pp::transaction> transaction;
+        Clock::time_point                       batchDeadline;
+        size_t                                  batchCount = 0;
+        std::vector<Book>                       writtenBooks;
+        std::vector<uint32_t>                   removedBookIds;
+
+        auto commit = [&]() {
+            if (!transaction)
+            {
+                return;
+            }
+            if (SQLITE_OK != transaction->commit())
+            {
+                std::cout << "Failed to commit library batch: " << _db.error_msg() << std::endl;
+                writtenBooks.clear();
+                removedBookIds.clear();
+            }
+            transaction.reset();
+            batchCount = 0;
+
+            for (auto& book : writtenBooks)
+            {
+                _writtenBooks.push(std::move(book));
+            }
+            for (auto bookId : removedBookIds)
+            {
+                _removedBookIds.push(bookId);
+            }
+            if (_published && (!writtenBooks.empty() || !removedBookIds.empty()))
+            {
+                _published();
+            }
+            writtenBooks.clear();
+            removedBookIds.clear();
+        };
+
+        // runs the job inside a savepoint, undoing only its own changes on failure
+        auto inSavepoint = [&](auto&& work) -> bool {
+            _db.execute("savepoint job");
+            bool success = work();
+            if (!success)
+            {
+                std::cout << "Library write failed: " << _db.error_msg() << std::endl;
+                _db.execute("rollback to job");
+            }
+            _db.execute("release job");
+            return success;
+        };
+
+        for (;;)
+        {
+            Job job;
+            if (!transaction)
+            {
+                _jobs.waitPop(job);
+            }
+            else if (!_jobs.waitPop(job, batchDeadline - Clock::now()))
+            {
+                // batch time is up
+                commit();
+                continue;
+            }
+
+            if (job.type == Job::Type::Stop || job.type == Job::Type::Flush)
+            {
+                commit();
+                if (job.flushed)
+                {
+                    job.flushed->set_value();
+                }
+                if (job.type == Job::Type::Stop)
+                {
+                    break;
+                }
+                continue;
+            }
+
+            if (!transaction)
+            {
+                transaction   = std::make_unique<sqlite3pp::transaction>(_db);
+                batchDeadline = Clock::now() + _batchTime;
+            }
+
+            switch (job.type)
+            {
+                case Job::Type::WriteBook:
+                    if (inSavepoint([&]() { return writeBook(job.book); }))
+                    {
+                        // the library list doesn't keep files around, same as books read from the database
+                        job.book.files.clear();
+                        writtenBooks.emplace_back(std::move(job.book));
+                    }
+                    break;
+                case Job::Type::RemoveBook:
+                    if (inSavepoint([&]() { return removeBook(job.bookId); }))
+                    {
+                        removedBookIds.push_back(job.bookId);
+                    }
+                    break;
+                case Job::Type::Clear:
+                    inSavepoint([&]() {
+                        return SQLITE_OK == _db.execute("delete from bookmarks") &&
+                               SQLITE_OK == _db.execute("delete from files") &&
+                               SQLITE_OK == _db.execute("delete from books") &&
+                               SQLITE_OK == _db.execute("delete from skipped_files");
+                    });
+                    break;
+                case Job::Type::WriteSkippedFiles:
+                    inSavepoint([&]() {
+                        if (!execute(deleteSkippedFiles, job.key))
+                        {
+                            return false;
+                        }
+                        for (const auto& file : job.skippedFiles)
+                        {
+                            if (!execute(insertSkippedFile, file.first, job.key, file.second))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    });
+                    break;
+                case Job::Type::WriteSetting:
+                    inSavepoint([&]() { return execute(writeSetting, job.key, job.text); });
+                    break;
+                case Job::Type::WriteCheckpoint:
+                {
+                    std::optional<Checkpoint> checkpoint;
+                    {
+                        std::lock_guard<std::mutex> lock(_checkpointMutex);
+                        checkpoint.swap(_checkpoint);
+                    }
+                    if (checkpoint)
+                    {
+                        inSavepoint([&]() {
+                            return execute(writeCheckpoint, int64_t(checkpoint->bookId), kLastBookMarkName,
+                                           checkpoint->filePath, checkpoint->position);
+                        });
+                        // worth losing as little of as possible, committed right away
+                        commit();
+                        continue;
+                    }
+                    break;
+                }
+                case Job::Type::WriteAnalysis:
+                    inSavepoint([&]() { return writeFileAnalysis(job.fileId, job.analysis); });
+                    break;
+                case Job::Type::WriteChapters:
+                    inSavepoint([&]() {
+                        return writeChapters(job.fileId, job.chapters) && execute(clearChaptersPending, job.fileId);
+                    });
+                    break;
+                case Job::Type::WriteBookSpeed:
+                    inSavepoint([&]() { return execute(writeBookSpeed, double(job.speed), int64_t(job.bookId)); });
+                    break;
+                case Job::Type::Execute:
+                    inSavepoint([&]() { return SQLITE_OK == _db.execute(job.text.c_str()); });
+                    break;
+                default:
+                    break;
+            }
+
+            if (++batchCount >= _batchBooks)
+            {
+                commit();
+            }
+        }
+    }
+
+    sqlite3pp::database&       _db;
+    ConcurrentQueue<Book>&     _writtenBooks;
+    ConcurrentQueue<uint32_t>& _removedBookIds;
+    ConcurrentQueue<Job>       _jobs;
+    std::mutex                 _checkpointMutex;
+    std::optional<Checkpoint>  _checkpoint;
+    std::function<void()>      _published;
+    std::thread                _thread;
+    size_t                     _batchBooks {1};
+    std::chrono::milliseconds  _batchTime {0};
+};
+
+// Measures the library's files in the background: the silences playback shortens pauses with, the loudness it
+// normalizes with and the waveform the scrubber draws. One file at a time on its own thread rather than on the task
+// scheduler, a file takes seconds to minutes and would hold a worker the library tasks need. A player whose audio
+// callbacks don't block decodes as fast as it can, in the file's own rate and at most two channels so the true peak
+// isn't hidden by a downmix. While a book plays the decoding is slowed down to a few times real time. Results go
+// through the writer one file at a time, so stopping loses at most the file in progress; files that fail are stored
+// without measurements and not tried again. Files stored before chapters were read get theirs first, that only
+// takes reading their headers.
+class AudioAnalyzer
+{
+public:
+    AudioAnalyzer(sqlite3pp::database& db, LibraryWriter& writer)
+        : _db(db)
+        , _writer(writer)
+    {
+    }
+
+    ~AudioAnalyzer()
+    {
+        stop();
+    }
+
+    void start(libvlc_instance_t* vlcInstance)
+    {
+        stop();
+        _vlcInstance = vlcInstance;
+        _stopping    = false;
+        _thread      = std::thread([this]() { run(); });
+    }
+
+    // Abandons the file being analyzed
+    void stop()
+    {
+        if (_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _condition.notify_all();
+            _thread.join();
+        }
+    }
+
+    // Files were added or changed
+    void request()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _requested = true;
+        }
+        _condition.notify_all();
+    }
+
+    // Bumped whenever analyses were committed
+    uint64_t version() const
+    {
+        return _version;
+    }
+
+    // Something is playing, leave it the CPU and the disk
+    void setThrottled(bool throttled)
+    {
+        _throttled = throttled;
+    }
+
+private:
+    struct PendingFile
+    {
+        int64_t     id {0};
+        std::string path;
+    };
+
+    // State of one file's decoding, shared with the libVLC threads
+    struct Analysis
+    {
+        explicit Analysis(AudioAnalyzer& owner)
+            : owner(owner)
+        {
+        }
+
+        AudioAnalyzer& owner;
+        // decoder thread while playing, made once the format is known
+        unsigned                       sampleRate {0};
+        unsigned                       channels {0};
+        std::optional<SilenceDetector> detector;
+        std::optional<LoudnessMeter>   meter;
+        std::optional<WaveformBuilder> waveform;
+        bool                           finished {false};
+        bool                           succeeded {false};
+    };
+
+    void run()
+    {
+        std::unordered_set<int64_t> attempted;
+        for (;;)
+        {
+            std::vector<PendingFile> chapterFiles = pendingChapterFiles();
+            for (const auto& file : chapterFiles)
+            {
+                if (isStopping())
+                {
+                    return;
+                }
+                _writer.writeChapters(file.id, readChapters(file.path));
+            }
+            if (!chapterFiles.empty())
+            {
+                _writer.flush();
+            }
+
+            std::vector<PendingFile> files = pendingFiles(attempted);
+            for (const auto& file : files)
+            {
+                FileAnalysis analysis;
+                bool         analyzed = analyze(file.path, analysis);
+                if (isStopping())
+                {
+                    return;
+                }
+                attempted.insert(file.id);
+                if (!analyzed)
+                {
+                    analysis        = FileAnalysis();
+                    analysis.failed = true;
+                }
+                _writer.writeAnalysis(file.id, std::move(analysis));
+            }
+            if (!files.empty())
+            {
+                // committed before looking for more
+                _writer.flush();
+                ++_version;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _requested || _stopping; });
+            _requested = false;
+            if (_stopping)
+            {
+                return;
+            }
+        }
+    }
+
+    bool isStopping()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stopping;
+    }
+
+    // the silences row marks a file as analyzed
+    std::vector<PendingFile> pendingFiles(const std::unordered_set<int64_t>& attempted)
+    {
+        static const char* const kSelectPending =
+            "select files.key, files.path from files left join silences on silences.file_id = files.key "
+            "where silences.file_id is null order by files.book_id, files.track_number";
+        std::vector<PendingFile> files;
+        sqlite3pp::query         query(_db, kSelectPending);
+        for (auto row : query)
+        {
+            PendingFile file;
+            std::tie(file.id, file.path) = row.get_columns<long long, char const*>(0, 1);
+            if (attempted.find(file.id) == attempted.end())
+            {
+                files.emplace_back(std::move(file));
+            }
+        }
+        return files;
+    }
+
+    std::vector<PendingFile> pendingChapterFiles()
+    {
+        std::vector<PendingFile> files;
+        sqlite3pp::query         query(_db, "select key, path from files where chapters_pending = 1");
+        for (auto row : query)
+        {
+            PendingFile file;
+            std::tie(file.id, file.path) = row.get_columns<long long, char const*>(0, 1);
+            files.emplace_back(std::move(file));
+        }
+        return files;
+    }
+
+    bool analyze(const std::string& path, FileAnalysis& outAnalysis)
+    {
+        libvlc_media_t* media = libvlc_media_new_path(_vlcInstance, path.c_str());
+        if (!media)
+        {
+            return false;
+        }
+        libvlc_media_add_option(media, ":no-video");
+        libvlc_media_player_t* player = libvlc_media_player_new_from_media(media);
+        libvlc_media_release(media);
+        if (!player)
+        {
+            return false;
+        }
+
+        Analysis analysis(*this);
+        libvlc_audio_set_callbacks(player, &AudioAnalyzer::onSamples, nullptr, nullptr, nullptr, nullptr, &analysis);
+        libvlc_audio_set_format_callbacks(player, &AudioAnalyzer::onSetup, nullptr);
+        libvlc_event_manager_t* eventManager = libvlc_media_player_event_manager(player);
+        for (auto eventType : {libvlc_MediaPlayerEndReached, libvlc_MediaPlayerEncounteredError})
+        {
+            libvlc_event_attach(eventManager, eventType, &AudioAnalyzer::onFinished, &analysis);
+        }
+
+        if (libvlc_media_player_play(player) == 0)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [&]() { return analysis.finished || _stopping; });
+        }
+        // joins the decoder, nothing touches the analysis afterwards
+        libvlc_media_player_stop(player);
+        libvlc_media_player_release(player);
+
+        if (!analysis.succeeded || !analysis.detector)
+        {
+            return false;
+        }
+        analysis.detector->finish();
+        outAnalysis.silences = analysis.detector->silences();
+        outAnalysis.loudness = analysis.meter->integratedLoudness();
+        outAnalysis.truePeak = analysis.meter->truePeak();
+        outAnalysis.waveform = analysis.waveform->finish();
+        return true;
+    }
+
+    // libVLC threads
+    static int onSetup(void** data, char* format, unsigned* rate, unsigned* channels)
+    {
+        Analysis& analysis = *static_cast<Analysis*>(*data);
+        if (analysis.detector)
+        {
+            // the format changed midway, keep measuring in the first one
+            *rate     = analysis.sampleRate;
+            *channels = analysis.channels;
+        }
+        else
+        {
+            analysis.sampleRate = *rate;
+            analysis.channels   = std::min(*channels, kAnalysisMaxChannels);
+            analysis.detector.emplace(int(*rate), int(analysis.channels), kMinSilenceMs);
+            analysis.meter.emplace(int(*rate), int(analysis.channels));
+            analysis.waveform.emplace(int(*rate), int(analysis.channels));
+            *channels = analysis.channels;
+        }
+        std::memcpy(format, "FL32", 4);
+        return 0;
+    }
+
+    static void onSamples(void* data, const void* samples, unsigned count, int64_t /*pts*/)
+    {
+        Analysis&    analysis = *static_cast<Analysis*>(data);
+        const float* source   = static_cast<const float*>(samples);
+        analysis.detector->feed(source, count);
+        analysis.meter->feed(source, count);
+        analysis.waveform->feed(source, count);
+        if (analysis.owner._throttled)
+        {
+            // paces the decoder, it calls again once this returns
+            std::this_thread::sleep_for(std::chrono::microseconds(
+                int64_t(count) * 1000000 / (int64_t(analysis.sampleRate) * kThrottledAnalysisSpeed)));
+        }
+    }
+
+    static void onFinished(const libvlc_event_t* event, void* userData)
+    {
+        Analysis& analysis = *static_cast<Analysis*>(userData);
+        {
+            std::lock_guard<std::mutex> lock(analysis.owner._mutex);
+            analysis.finished  = true;
+            analysis.succeeded = event->type == libvlc_MediaPlayerEndReached;
+        }
+        analysis.owner._condition.notify_all();
+    }
+
+    sqlite3pp::database&    _db;  // read only, this thread only
+    LibraryWriter&          _writer;
+    libvlc_instance_t*      _vlcInstance {nullptr};
+    std::thread             _thread;
+    std::mutex              _mutex;
+    std::condition_variable _condition;
+    bool                    _requested {false};
+    bool                    _stopping {false};
+    std::atomic<bool>       _throttled {false};
+    std::atomic<uint64_t>   _version {0};
+};
+
+struct BookFile
+{
+    fs::path path;
+    int64_t  lastModified {0};
+
+    bool operator<(const BookFile& other) const
+    {
+        return path < other.path;
+    }
+};
+
+// Folder holding the files of one book, produced by the enumeration phase of the discovery
+struct BookFolder
+{
+    std::string           folder;
+    std::vector<BookFile> files;
+};
+
+// Columns read by readBook(), qualified so they can be selected from joins
+static const std::string kBookColumns = "books.key, books.duration, books.author, books.name, books.series, "
+                                        "books.description, books.path, books.thumbnail_path";
+
+Book readBook(sqlite3pp::query::rows& row)
+{
+    Book book;
+    std::tie(book.id, book.duration, book.author, book.name, book.series, book.description, book.folder,
+             book.thumbnailLocation) =
+        row.get_columns<long, long long, char const*, char const*, char const*, char const*, char const*,
+                        char const*>(0, 1, 2, 3, 4, 5, 6, 7);
+    return book;
+}
+
+// Windowed view over the books table ordered by name. Only the pages the UI touches are loaded, walking from a
+// loaded page to its neighbours uses keyset pagination on (name, key) so it costs the same anywhere in the
+// library. Jumping to a page with no loaded neighbour falls back to an offset query once. Least recently used
+// pages are dropped when more than kMaxCachedPages are loaded. Covers are not part of a page, see CoverCache.
+class BookPages
+{
+public:
+    explicit BookPages(sqlite3pp::database& db)
+        : _db(db)
+    {
+    }
+
+    size_t size()
+    {
+        if (!_count)
+        {
+            sqlite3pp::query query(_db, "select count(*) from books");
+            _count = 0;
+            for (auto row : query)
+            {
+                _count = size_t(row.get<long long>(0));
+            }
+        }
+        return *_count;
+    }
+
+    bool empty()
+    {
+        return size() == 0;
+    }
+
+    // Returns nullptr past the end of the library
+    Book* bookAt(size_t index)
+    {
+        Page* page = loadPage(index / kPageSize);
+        if (!page || index % kPageSize >= page->books.size())
+        {
+            return nullptr;
+        }
+        return &page->books[index % kPageSize];
+    }
+
+    // Loads at most one missing page next to the given range, meant to be called once per frame
+    void prefetch(size_t firstIndex, size_t lastIndex)
+    {
+        size_t firstPage = firstIndex / kPageSize;
+        size_t lastPage  = lastIndex / kPageSize;
+        for (size_t pageIndex : {lastPage + 1, firstPage > 0 ? firstPage - 1 : lastPage + 1})
+        {
+            if (pageIndex * kPageSize < size() && _pages.find(pageIndex) == _pages.end())
+            {
+                loadPage(pageIndex);
+                return;
+            }
+        }
+    }
+
+    // Forgets everything loaded, the next access reads the current content of the table
+    void clear()
+    {
+        _pages.clear();
+        _pageAfter.clear();
+        _count.reset();
+    }
+
+private:
+    static const size_t kPageSize       = 64;
+    static const size_t kMaxCachedPages = 16;
+
+    struct Page
+    {
+        std::vector<Book> books;
+        uint64_t          lastUse {0};
+    };
+
+    // Sort key of a row, a page starts right after the key of the previous page's last row
+    struct RowKey
+    {
+        std::string name;
+        long long   key;
+    };
+
+    Page* loadPage(size_t pageIndex)
+    {
+        auto pageIt = _pages.find(pageIndex);
+        if (pageIt != _pages.end())
+        {
+            pageIt->second.lastUse = ++_useCounter;
+            return &pageIt->second;
+        }
+
+        if (pageIndex * kPageSize >= size())
+        {
+            return nullptr;
+        }
+
+        static const std::string kColumns = "select " + kBookColumns + " from books ";
+        std::unique_ptr<sqlite3pp::query> query;
+        auto                              afterIt = _pageAfter.find(pageIndex);
+        if (pageIndex == 0)
+        {
+            query = std::make_unique<sqlite3pp::query>(_db, (kColumns + "order by name, key limit ?").c_str());
+            query->bind(1, int(kPageSize));
+        }
+        else if (afterIt != _pageAfter.end())
+        {
+            query = std::make_unique<sqlite3pp::query>(
+                _db, (kColumns + "where (name, key) > (?, ?) order by name, key limit ?").c_str());
+            query->bind(1, afterIt->second.name, sqlite3pp::copy);
+            query->bind(2, afterIt->second.key);
+            query->bind(3, int(kPageSize));
+        }
+        else
+        {
+            query = std::make_unique<sqlite3pp::query>(_db,
+                                                       (kColumns + "order by name, key limit ? offset ?").c_str());
+            query->bind(1, int(kPageSize));
+            query->bind(2, (long long)(pageIndex * kPageSize));
+        }
+
+        Page page;
+        page.books.reserve(kPageSize);
+        for (auto row : *query)
+        {
+            page.books.emplace_back(readBook(row));
+        }
+
+        if (page.books.empty())
+        {
+            return nullptr;
+        }
+
+        const Book& lastBook      = page.books.back();
+        _pageAfter[pageIndex + 1] = {lastBook.name, (long long)lastBook.id};
+
+        evictPages();
+        page.lastUse = ++_useCounter;
+        return &_pages.emplace(pageIndex, std::move(page)).first->second;
+    }
+
+    void evictPages()
+    {
+        while (_pages.size() >= kMaxCachedPages)
+        {
+            auto oldest = std::min_element(_pages.begin(), _pages.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.second.lastUse < rhs.second.lastUse;
+            });
+            _pages.erase(oldest);
+        }
+    }
+
+    sqlite3pp::database&               _db;
+    std::unordered_map<size_t, Page>   _pages;
+    std::unordered_map<size_t, RowKey> _pageAfter;
+    std::optional<size_t>              _count;
+    uint64_t                           _useCounter {0};
+};
+
+struct Library
+{
+    enum class State {
+        Idle,
+        Working
+    };
+
+    std::atomic<State>                   _state {State::Idle};
+    LibraryDatabase                      _database;
+    sqlite3pp::database                  _libraryDb;  // read only, UI thread
+    sqlite3pp::database                  _scanDb;     // read only, library tasks
+    sqlite3pp::database                  _writerDb;   // used by the writer thread only
+    sqlite3pp::database                  _analysisDb;  // read only, analysis thread
+    std::unique_ptr<enki::TaskScheduler> _taskScheduler;
+    std::unique_ptr<enki::TaskSet>       _currentTask;
+    libvlc_instance_t*                   _vlcInstance {nullptr};  // shared VLC instance with the player
+    MediaParser                          _mediaParser;
+    BookPages                            _books;   // UI thread only
+    ThumbnailStore                       _thumbnails;
+    CoverCache                           _covers;  // UI thread only
+    std::string                          _libraryPath;
+    Texture                              _genericCover;
+    LibraryWatcher                       _watcher;
+    ConcurrentQueue<std::string>         _changedFolders;  // reported by the watcher
+    ConcurrentQueue<Book>                _updatedBooks;    // written in the background, waiting for the UI thread
+    ConcurrentQueue<uint32_t>            _removedBookIds;
+    LibraryWriter                        _writer;
+    AudioAnalyzer                        _analyzer;
+    std::function<void()>                _wake;
+    uint64_t                             _booksVersion {0};  // bumped whenever the UI sees changed books
+
+    Library()
+        : _taskScheduler(std::make_unique<enki::TaskScheduler>())
+        , _books(_libraryDb)
+        , _covers(*_taskScheduler, _thumbnails)
+        , _writer(_writerDb, _updatedBooks, _removedBookIds)
+        , _analyzer(_analysisDb, _writer)
+    {
+    }
+
+    ~Library()
+    {
+        _watcher.stop();
+        _taskScheduler->WaitforAllAndShutdown();
+        _analyzer.stop();
+        _writer.stop();
+        _libraryDb.disconnect();
+        _scanDb.disconnect();
+        _writerDb.disconnect();
+        _analysisDb.disconnect();
+    }
+
+    bool isEmpty()
+    {
+        return _books.empty();
+    }
+
+    bool init(libvlc_instance_t* vlcInstance)
+    {
+        _vlcInstance = vlcInstance;
+        _taskScheduler->Initialize();
+        _mediaParser.init(_vlcInstance, kMaxParsesInFlight, kParseTimeoutMs);
+
+        // Initialize database
+        fs::path dbPath = fs::current_path();
+        dbPath.append(kLibraryDb);
+        if (!_database.openWriter(dbPath.string(), _writerDb) || !_database.openReader(_libraryDb) ||
+            !_database.openReader(_scanDb) || !_database.openReader(_analysisDb))
+        {
+            return false;
+        }
+
+        if (!_thumbnails.open((fs::current_path() / kThumbnailDir).string(), kThumbnailSize))
+        {
+            return false;
+        }
+
+        _genericCover = loadImage("generic_cover.png");
+        if (!_genericCover.handle)
+        {
+            return false;
+        }
+        _covers.setFallback(_genericCover);
+
+        _writer.start(kWriterBatchBooks, kWriterBatchTime);
+        _analyzer.start(_vlcInstance);
+        _libraryPath = readSetting(kSettingLibraryPath);
+        if (!_libraryPath.empty())
+        {
+            startWatching();
+            if (_database.needsRescan())
+            {
+                // picked up by update() like a folder the watcher reported
+                _changedFolders.push(_libraryPath);
+            }
+        }
+
+        return true;
+    }
+
+    enum class DiscoveryMode
+    {
+        Full,         // forget everything and parse the whole library
+        Incremental,  // parse only book folders changed since they were stored
+    };
+
+    bool startLibraryDiscovery(const std::string& pathName, DiscoveryMode mode = DiscoveryMode::Full)
+    {
+        if (_state != State::Idle)
+        {
+            return false;
+        }
+
+        waitForCurrentTask();
+        _currentTask = std::make_unique<enki::TaskSet>([pathName, mode, this](enki::TaskSetPartition range,
+                                                                              uint32_t               threadnum) {
+            fs::path path(pathName);
+            if (!fs::exists(path) || !fs::is_directory(path))
+            {
+                finishTask();
+                return;
+            }
+
+            if (mode == DiscoveryMode::Incremental)
+            {
+                rescanFolder(path, path);
+                _writer.flush();
+                finishTask();
+                return;
+            }
+
+            _writer.clear();
+
+            // enumerate first so the expensive parsing can be spread over all worker threads
+            std::vector<BookFolder> bookFolders = enumerateBookFolders(path, path);
+            std::vector<Book>       books       = parseBookFolders(bookFolders);
+
+            for (size_t i = 0; i < books.size(); ++i)
+            {
+                writeSkippedFiles(bookFolders[i], books[i]);
+                // make sure not empty
+                if (books[i].files.size())
+                {
+                    _writer.writeBook(std::move(books[i]));
+                }
+            }
+            _writer.flush();
+            finishTask();
+        });
+        _libraryPath = pathName;
+        writeSetting(kSettingLibraryPath, pathName);
+        _state = State::Working;
+        _taskScheduler->AddTaskSetToPipe(_currentTask.get());
+        startWatching();
+
+        return true;
+    }
+
+    // Last thing a library task does, the UI may be sleeping and has to pick up the results
+    void finishTask()
+    {
+        _state = State::Idle;
+        _analyzer.request();
+        wake();
+    }
+
+    // Before the VLC instance goes away
+    void stopAnalysis()
+    {
+        _analyzer.stop();
+    }
+
+    void setAnalysisThrottled(bool throttled)
+    {
+        _analyzer.setThrottled(throttled);
+    }
+
+    // Changes when analyses were committed, books missing some may want to read them again
+    uint64_t analysisVersion() const
+    {
+        return _analyzer.version();
+    }
+
+    // the previous task may still be returning after flipping the state back to idle
+    void waitForCurrentTask()
+    {
+        if (_currentTask)
+        {
+            _taskScheduler->WaitforTask(_currentTask.get());
+        }
+    }
+
+    void startWatching()
+    {
+        _watcher.start(_libraryPath, [this](std::vector<std::string>&& folders) {
+            for (auto& folder : folders)
+            {
+                _changedFolders.push(std::move(folder));
+            }
+            wake();
+        });
+    }
+
+    // Set before init(), called from background threads whenever update() has new work
+    void setWakeCallback(std::function<void()> wakeCallback)
+    {
+        _wake = std::move(wakeCallback);
+        _writer.setPublishedCallback([this]() { wake(); });
+    }
+
+    void wake()
+    {
+        if (_wake)
+        {
+            _wake();
+        }
+    }
+
+    // True if update() has work left for the next frame
+    bool needsUpdate() const
+    {
+        return _covers.needsUpdate() || !_updatedBooks.empty() || !_removedBookIds.empty() ||
+               (_state == State::Idle && !_changedFolders.empty());
+    }
 
-        if (imageData)
+    // Called on the UI thread every frame, refreshes the loaded pages when books were changed in the background and
+    // starts processing folders reported by the watcher when no other library task runs
+    void update()
+    {
+        _covers.update();
+
+        bool     booksChanged = false;
+        uint32_t removedBookId;
+        while (_removedBookIds.tryPop(removedBookId))
         {
-            glGenTextures(1, &texture.handle);
-            glBindTexture(GL_TEXTURE_2D, texture.handle);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            int internalFormat = GL_RGBA;
-            int format = GL_RGBA;
-            int unpackAlignment = 4;
-            if (channels == 3)
+            booksChanged = true;
+        }
+        Book updatedBook;
+        while (_updatedBooks.tryPop(updatedBook))
+        {
+            booksChanged = true;
+        }
+        if (booksChanged)
+        {
+            _books.clear();
+            ++_booksVersion;
+        }
+
+        if (_state != State::Idle || _changedFolders.empty())
+        {
+            return;
+        }
+
+        std::set<std::string> folders;
+        std::string           folder;
+        while (_changedFolders.tryPop(folder))
+        {
+            folders.emplace(std::move(folder));
+        }
+
+        waitForCurrentTask();
+        _currentTask = std::make_unique<enki::TaskSet>(
+            [folders = std::move(folders), this](enki::TaskSetPartition range, uint32_t threadnum) {
+                fs::path rootPath(_libraryPath);
+                for (const auto& changedFolder : folders)
+                {
+                    rescanFolder(rootPath, changedFolder);
+                }
+                _writer.flush();
+                finishTask();
+            });
+        _state = State::Working;
+        _taskScheduler->AddTaskSetToPipe(_currentTask.get());
+    }
+
+    // Diffs scopePath (the library root or any folder below it) against the files and skipped_files tables and
+    // re-parses only the book folders having new, modified or removed files. Stored books under scopePath whose folder
+    // disappeared are removed, untouched folders cost one stat per file, including folders with nothing playable.
+    // Changes go through the writer which publishes them to the UI thread, see update().
+    void rescanFolder(const fs::path& rootPath, const fs::path& scopePath)
+    {
+        struct StoredFile
+        {
+            int64_t bookId;
+            int64_t lastModified;
+        };
+
+        // everything below scopePath sorts between "scopePath/" and the same prefix with the separator incremented
+        std::string lowerBound = (scopePath / "").string();
+        std::string upperBound = lowerBound;
+        upperBound.back()++;
+        std::string scopeFolder = scopePath.string();
+
+        std::unordered_map<std::string, StoredFile> storedFiles;
+        std::unordered_map<std::string, int64_t>    storedBooks;
+        std::unordered_map<int64_t, size_t>         storedFileCount;
+        std::unordered_map<std::string, int64_t>    skippedFiles;
+        std::set<std::string>                       skippedFolders;
+        {
+            sqlite3pp::query query(_scanDb,
+                                   "select book_id, last_modified, path from files where path >= ? and path < ?");
+            query.bind(1, lowerBound, sqlite3pp::nocopy);
+            query.bind(2, upperBound, sqlite3pp::nocopy);
+            for (auto row : query)
+            {
+                StoredFile  storedFile;
+                const char* filePath;
+                std::tie(storedFile.bookId, storedFile.lastModified, filePath) =
+                    row.get_columns<long long, long long, char const*>(0, 1, 2);
+                storedFiles.emplace(ValueOrEmpty(filePath), storedFile);
+                ++storedFileCount[storedFile.bookId];
+            }
+        }
+        {
+            sqlite3pp::query query(_scanDb, "select key, path from books where path = ? or (path >= ? and path < ?)");
+            query.bind(1, scopeFolder, sqlite3pp::nocopy);
+            query.bind(2, lowerBound, sqlite3pp::nocopy);
+            query.bind(3, upperBound, sqlite3pp::nocopy);
+            for (auto row : query)
+            {
+                int64_t     bookId;
+                const char* folder;
+                std::tie(bookId, folder) = row.get_columns<long long, char const*>(0, 1);
+                storedBooks.emplace(ValueOrEmpty(folder), bookId);
+            }
+        }
+        {
+            sqlite3pp::query query(
+                _scanDb, "select last_modified, path, folder from skipped_files where path >= ? and path < ?");
+            query.bind(1, lowerBound, sqlite3pp::nocopy);
+            query.bind(2, upperBound, sqlite3pp::nocopy);
+            for (auto row : query)
+            {
+                int64_t     lastModified;
+                const char* filePath;
+                const char* folder;
+                std::tie(lastModified, filePath, folder) =
+                    row.get_columns<long long, char const*, char const*>(0, 1, 2);
+                skippedFiles.emplace(ValueOrEmpty(filePath), lastModified);
+                skippedFolders.emplace(ValueOrEmpty(folder));
+            }
+        }
+
+        std::vector<BookFolder> bookFolders = enumerateBookFolders(scopePath, rootPath);
+        std::vector<BookFolder> changedFolders;
+        std::vector<int64_t>    changedBookIds;
+        for (auto& bookFolder : bookFolders)
+        {
+            auto    bookIt      = storedBooks.find(bookFolder.folder);
+            int64_t bookId      = bookIt != storedBooks.end() ? bookIt->second : 0;
+            size_t  storedCount = 0;
+            bool    changed     = false;
+            // every file on disk is either stored with the book or skipped, unchanged in both cases
+            for (size_t i = 0; !changed && i < bookFolder.files.size(); ++i)
+            {
+                const BookFile& file   = bookFolder.files[i];
+                auto            fileIt = storedFiles.find(file.path.string());
+                if (bookId && fileIt != storedFiles.end() && fileIt->second.bookId == bookId &&
+                    fileIt->second.lastModified == file.lastModified)
+                {
+                    ++storedCount;
+                    continue;
+                }
+                auto skippedIt = skippedFiles.find(file.path.string());
+                changed        = skippedIt == skippedFiles.end() || skippedIt->second != file.lastModified;
+            }
+            // and no stored file of the book is gone
+            changed = changed || (bookId && storedFileCount[bookId] != storedCount);
+            skippedFolders.erase(bookFolder.folder);
+
+            if (bookIt != storedBooks.end())
             {
-                internalFormat = GL_RGB;
-                format = GL_RGB;
-                glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                storedBooks.erase(bookIt);
             }
-            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, imageData);
-            if (channels == 3)
+            if (changed)
             {
-                glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+                changedFolders.emplace_back(std::move(bookFolder));
+                changedBookIds.push_back(bookId);
             }
-            stbi_image_free(imageData);
+        }
 
-            texture.aspectRatio = float(width) / height;
+        // whatever is left wasn't found on disk anymore
+        for (const auto& removedBook : storedBooks)
+        {
+            _writer.removeBook(uint32_t(removedBook.second));
+        }
+        for (const auto& removedFolder : skippedFolders)
+        {
+            _writer.writeSkippedFiles(removedFolder, {});
         }
 
-        return texture;
+        std::vector<Book> books = parseBookFolders(changedFolders);
+        for (size_t i = 0; i < books.size(); ++i)
+        {
+            Book& book = books[i];
+            book.id    = uint32_t(changedBookIds[i]);
+            writeSkippedFiles(changedFolders[i], book);
+            if (!book.files.empty())
+            {
+                _writer.writeBook(std::move(book));
+            }
+            else if (book.id)
+            {
+                // nothing playable left inside
+                _writer.removeBook(book.id);
+            }
+        }
     }
 
-    void clearDb() { }
+    // Remembers the files of bookFolder that didn't make it into its parsed book, so rescans leave them alone until
+    // they change
+    void writeSkippedFiles(const BookFolder& bookFolder, const Book& book)
+    {
+        std::unordered_set<std::string> parsedPaths;
+        for (const auto& file : book.files)
+        {
+            parsedPaths.insert(file.path);
+        }
 
-    void setDefaultSettings()
+        std::vector<std::pair<std::string, int64_t>> skipped;
+        for (const auto& file : bookFolder.files)
+        {
+            std::string filePath = file.path.string();
+            if (parsedPaths.find(filePath) == parsedPaths.end())
+            {
+                skipped.emplace_back(std::move(filePath), file.lastModified);
+            }
+        }
+        _writer.writeSkippedFiles(bookFolder.folder, std::move(skipped));
+    }
+
+    // Collects every folder below scopePath, scopePath included, holding at least one playable file. Folders are
+    // sorted by path and files sorted by name.
+    std::vector<BookFolder> enumerateBookFolders(const fs::path& scopePath, const fs::path& rootPath) const
     {
-        // removeFrom database
-        sqlite3pp::command cmd(_libraryDb, "drop table settings");
-        if (SQLITE_OK != cmd.execute())
+        std::map<std::string, BookFolder> foldersByPath;
+        std::error_code                   errorCode;
+        fs::recursive_directory_iterator  rdi(scopePath, fs::directory_options::skip_permission_denied, errorCode);
+        for (; !errorCode && rdi != fs::recursive_directory_iterator(); rdi.increment(errorCode))
+        {
+            const auto& entry = *rdi;
+            if (!entry.is_regular_file(errorCode))
+            {
+                continue;
+            }
+
+            const fs::path& filePath = entry.path();
+            // files laying directly in the library root don't belong to any book
+            if (filePath.parent_path() == rootPath)
+            {
+                continue;
+            }
+
+            if (kIgnoreExtensions.find(filePath.extension().string()) != kIgnoreExtensions.end())
+            {
+                // skip this file
+                continue;
+            }
+
+            std::string folder     = filePath.parent_path().string();
+            BookFolder& bookFolder = foldersByPath[folder];
+            bookFolder.folder      = folder;
+            bookFolder.files.push_back({filePath, toMilliseconds(entry.last_write_time(errorCode))});
+        }
+
+        std::vector<BookFolder> bookFolders;
+        bookFolders.reserve(foldersByPath.size());
+        for (auto& folderEntry : foldersByPath)
         {
-            std::cout << "Failed to drop settings table" << std::endl;
+            BookFolder& bookFolder = folderEntry.second;
+            std::sort(bookFolder.files.begin(), bookFolder.files.end());
+            bookFolders.emplace_back(std::move(bookFolder));
         }
+        return bookFolders;
     }
 
-    bool writeBookToDb(const Book& bookInfo)
+    // Parses all files of the given folders and returns one book per folder, in the same order. Every folder is a
+    // separate item of the task set, its files are queued on the media parser which keeps a bounded number of
+    // asynchronous libVLC parses running. Completions are picked up by whichever thread gets to them first and
+    // stored at the file's index, so the result doesn't depend on thread scheduling.
+    std::vector<Book> parseBookFolders(const std::vector<BookFolder>& bookFolders)
     {
-        // start transaction
-        sqlite3pp::transaction tr(_libraryDb);
-        // use lambda to be able to break out early if anything goes wrong
-        bool success = [&]() -> bool {
-            sqlite3pp::command cmd(
-                _libraryDb,
-                "insert into books (duration, author, name, series, description, path, thumbnail_path) values (?, ?, ?, ?, ?, ?, ?)");
-            cmd.binder() << int64_t(bookInfo.duration) << bookInfo.author << bookInfo.name << bookInfo.series
-                         << bookInfo.description << bookInfo.folder << bookInfo.thumbnailLocation;
-            if (SQLITE_OK != cmd.execute())
+        std::vector<size_t> firstFileIndex(bookFolders.size());
+        size_t              fileCount = 0;
+        for (size_t i = 0; i < bookFolders.size(); ++i)
+        {
+            firstFileIndex[i] = fileCount;
+            fileCount += bookFolders[i].files.size();
+        }
+
+        std::vector<Media>   parsedFiles(fileCount);
+        std::vector<uint8_t> parsedOk(fileCount, 0);
+        std::atomic<size_t>  completedCount {0};
+
+        auto storeCompletion = [&](MediaParser::Completion& completion) {
+            parsedOk[completion.cookie]    = completion.parsed;
+            parsedFiles[completion.cookie] = std::move(completion.media);
+            ++completedCount;
+        };
+
+        enki::TaskSet parseTask(
+            uint32_t(bookFolders.size()), [&](enki::TaskSetPartition range, uint32_t threadnum) {
+                MediaParser::Completion completion;
+                for (uint32_t i = range.start; i < range.end; ++i)
+                {
+                    size_t fileIndex = firstFileIndex[i];
+                    for (const auto& bookFile : bookFolders[i].files)
+                    {
+                        _mediaParser.submit(bookFile.path, bookFile.lastModified, fileIndex++);
+                        while (_mediaParser.tryPopCompleted(completion))
+                        {
+                            storeCompletion(completion);
+                        }
+                    }
+                }
+            });
+        parseTask.m_MinRange = 1;
+        _taskScheduler->AddTaskSetToPipe(&parseTask);
+        _taskScheduler->WaitforTask(&parseTask);
+
+        // everything is submitted, wait for the parses still in flight
+        MediaParser::Completion completion;
+        while (completedCount < fileCount)
+        {
+            _mediaParser.waitCompleted(completion);
+            storeCompletion(completion);
+        }
+
+        // the tag reader only sees that a file has a cover, libVLC extracts it: one file per book that has no other
+        std::vector<size_t> coverFiles;
+        for (size_t i = 0; i < bookFolders.size(); ++i)
+        {
+            size_t end        = firstFileIndex[i] + bookFolders[i].files.size();
+            bool   hasArtwork = false;
+            size_t coverFile  = end;
+            for (size_t fileIndex = firstFileIndex[i]; fileIndex < end; ++fileIndex)
             {
-                return false;
+                hasArtwork |= parsedOk[fileIndex] && !parsedFiles[fileIndex].meta.artworkUrl.empty();
+                if (coverFile == end && parsedOk[fileIndex] && parsedFiles[fileIndex].hasEmbeddedCover)
+                {
+                    coverFile = fileIndex;
+                }
+            }
+            if (!hasArtwork && coverFile != end)
+            {
+                coverFiles.push_back(coverFile);
+            }
+        }
+        for (size_t fileIndex : coverFiles)
+        {
+            const Media& file = parsedFiles[fileIndex];
+            _mediaParser.submit(file.path, file.lastModified, fileIndex, true);
+        }
+        for (size_t i = 0; i < coverFiles.size(); ++i)
+        {
+            _mediaParser.waitCompleted(completion);
+            if (completion.parsed)
+            {
+                parsedFiles[completion.cookie].meta.artworkUrl = completion.media.meta.artworkUrl;
             }
+        }
 
-            int64_t bookId = _libraryDb.last_insert_rowid();
+        std::vector<Book> books(bookFolders.size());
+        for (size_t i = 0; i < bookFolders.size(); ++i)
+        {
+            Book& book  = books[i];
+            book.folder = bookFolders[i].folder;
+            book.name   = fs::path(book.folder).filename().string();
+            for (size_t fileIndex = firstFileIndex[i]; fileIndex < firstFileIndex[i] + bookFolders[i].files.size();
+                 ++fileIndex)
+            {
+                if (parsedOk[fileIndex])
+                {
+                    book.files.emplace_back(std::move(parsedFiles[fileIndex]));
+                }
+            }
 
-            for (const auto& media : bookInfo.files)
+            if (!book.files.empty())
             {
-                sqlite3pp::command cmd(
-                    _libraryDb, "insert into files (book_id, last_modified, track_number, path) values (?, ?, ?, ?)");
-                cmd.binder() << bookId << media.lastModified
-                             << (media.meta.trackNumber.empty() ? 0 : std::stoi(media.meta.trackNumber)) << media.path;
-                if (SQLITE_OK != cmd.execute())
+                resolveBookInfo(book);
+            }
+        }
+
+        // pre-scale the covers now, the library view then only ever reads small thumbnails
+        enki::TaskSet thumbnailTask(uint32_t(books.size()), [&](enki::TaskSetPartition range, uint32_t threadnum) {
+            for (uint32_t i = range.start; i < range.end; ++i)
+            {
+                if (!books[i].thumbnailLocation.empty())
                 {
-                    return false;
+                    _thumbnails.update(imagePathFromLocation(books[i].thumbnailLocation));
                 }
             }
-            return true;
-        }();  // notice the lambda being called
-        if (success)
+        });
+        _taskScheduler->AddTaskSetToPipe(&thumbnailTask);
+        _taskScheduler->WaitforTask(&thumbnailTask);
+        return books;
+    }
+
+    void resolveBookInfo(Book& book)
+    {
+
+        if (!book.name.empty() && book.files.size() > 1)
+        {
+            if (book.files[0].meta.name == book.files[1].meta.name)
+            {
+                book.name = book.files[0].meta.name;
+            }
+        }
+
+        // try get the name from meta info
+        if (book.name.empty())
         {
-            tr.commit();
+            for (const auto& file : book.files)
+            {
+                if (!file.meta.name.empty())
+                {
+                    book.name = file.meta.name;
+                    break;
+                }
+            }
         }
-        else
+
+        // try get author from meta
+        if (book.author.empty())
+        {
+            for (const auto& file : book.files)
+            {
+                if (!file.meta.author.empty())
+                {
+                    book.author = file.meta.author;
+                    break;
+                }
+            }
+        }
+
+        // if not found in meta, get name from folder name
+        if (book.name.empty())
+        {
+            fs::path bookFolder(book.folder);
+            book.name = bookFolder.filename().string();
+        }
+
+        // try retrieving artwork from meta
+        if (book.thumbnailLocation.empty())
+        {
+            for (const auto& file : book.files)
+            {
+                if (!file.meta.artworkUrl.empty())
+                {
+                    book.thumbnailLocation = file.meta.artworkUrl;
+                    break;
+                }
+            }
+        }
+
+        // if not found in meta info try looking for an image inside folder, libVLC only does when it parses a file
+        if (book.thumbnailLocation.empty())
+        {
+            book.thumbnailLocation = findFolderCover(book.folder);
+        }
+
+        for (const auto& file : book.files)
+        {
+            book.duration += file.duration;
+        }
+    }
+
+    // Ranked full text search over name, author, series and description. Every word of the text has to match the
+    // start of a word in one of them, so results narrow down while the user is typing. UI thread.
+    std::vector<Book> search(const std::string& text, size_t limit)
+    {
+        std::string        match;
+        std::istringstream words(text);
+        for (std::string word; words >> word;)
+        {
+            // quoted so fts5 operators typed by the user are taken literally
+            std::string quoted;
+            for (char c : word)
+            {
+                quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+            }
+            match += (match.empty() ? "\"" : " \"") + quoted + "\"*";
+        }
+
+        std::vector<Book> books;
+        if (match.empty())
+        {
+            return books;
+        }
+
+        // name weighs most, then author, series and description
+        static const std::string kSearch = "select " + kBookColumns +
+                                           " from books_fts join books on books.key = books_fts.rowid where books_fts "
+                                           "match ? order by bm25(books_fts, 10.0, 5.0, 2.0, 1.0) limit ?";
+        sqlite3pp::query         query(_libraryDb, kSearch.c_str());
+        query.bind(1, match, sqlite3pp::nocopy);
+        query.bind(2, int(limit));
+        for (auto row : query)
+        {
+            books.emplace_back(readBook(row));
+        }
+        return books;
+    }
+
+    Texture loadImage(const std::string& filename)
+    {
+        return uploadImage(decodeImage(filename));
+    }
+
+    // Cover to draw for the book, the generic one until its own is decoded and uploaded
+    const TextureRegion& cover(const Book& book)
+    {
+        return _covers.get(book.id, book.thumbnailLocation);
+    }
+
+    std::optional<Book> loadBook(uint32_t bookId)
+    {
+        static const std::string kSelectBook = "select " + kBookColumns + " from books where key = ?";
+        sqlite3pp::query         query(_libraryDb, kSelectBook.c_str());
+        query.bind(1, (long long)bookId);
+        for (auto row : query)
+        {
+            return readBook(row);
+        }
+        return {};
+    }
+
+    // Where the book was left, the start of the book if it never played
+    BookTimeline::Location readResumePoint(uint32_t bookId, const std::vector<PlaybackFile>& files)
+    {
+        static const char* const kSelectResumePoint =
+            "select files.path, bookmarks.position from bookmarks join files on files.key = bookmarks.file_id "
+            "where bookmarks.book_id = ? and bookmarks.name = ?";
+        sqlite3pp::query query(_libraryDb, kSelectResumePoint);
+        query.bind(1, (long long)bookId);
+        query.bind(2, kLastBookMarkName, sqlite3pp::nocopy);
+
+        BookTimeline::Location location;
+        for (auto row : query)
+        {
+            std::string path;
+            int64_t     position;
+            std::tie(path, position) = row.get_columns<char const*, long long>(0, 1);
+            auto fileIt = std::find_if(files.begin(), files.end(),
+                                       [&path](const PlaybackFile& file) { return file.path == path; });
+            if (fileIt != files.end())
+            {
+                location.fileIndex = size_t(fileIt - files.begin());
+                location.offset    = position;
+            }
+        }
+        return location;
+    }
+
+    void writeCheckpoint(uint32_t bookId, const std::string& filePath, int64_t position)
+    {
+        _writer.writeCheckpoint(bookId, filePath, position);
+    }
+
+    // Null if the book plays at the default speed
+    std::optional<float> readBookSpeed(uint32_t bookId)
+    {
+        sqlite3pp::query query(_libraryDb, "select speed from books where key = ? and speed is not null");
+        query.bind(1, (long long)bookId);
+        for (auto row : query)
         {
-            tr.rollback();
+            return float(row.get<double>(0));
         }
-        return success;
+        return std::nullopt;
+    }
+
+    void writeBookSpeed(uint32_t bookId, float speed)
+    {
+        _writer.writeBookSpeed(bookId, speed);
+    }
+
+    // The book's files in playing order
+    std::vector<PlaybackFile> readBookFiles(uint32_t bookId)
+    {
+        static const char* const  kSelectFiles =
+            "select files.path, files.duration, silences.file_id, silences.ranges, files.loudness, files.true_peak "
+            "from files left join silences on silences.file_id = files.key and not silences.failed "
+            "where files.book_id = ? order by files.track_number, files.path";
+        std::vector<PlaybackFile> files;
+        sqlite3pp::query          query(_libraryDb, kSelectFiles);
+        query.bind(1, (long long)bookId);
+        for (auto row : query)
+        {
+            PlaybackFile file;
+            std::tie(file.path, file.duration) = row.get_columns<char const*, long long>(0, 1);
+            if (row.column_type(2) != SQLITE_NULL)
+            {
+                // analyzed, null ranges mean there is nothing to skip. Files that failed are left to the live detector.
+                file.silences = std::make_shared<const SilenceMap>(
+                    decodeSilenceMap(row.get<void const*>(3), size_t(row.column_bytes(3))));
+            }
+            if (row.column_type(4) != SQLITE_NULL && row.column_type(5) != SQLITE_NULL)
+            {
+                file.gain = normalizationGain(row.get<double>(4), row.get<double>(5));
+            }
+            files.emplace_back(std::move(file));
+        }
+        return files;
+    }
+
+    // Positions in the book laid out by the timeline, files without a chapter table are a chapter each
+    BookChapters readBookChapters(uint32_t bookId, const BookTimeline& timeline)
+    {
+        static const char* const kSelectChapters =
+            "select files.key, files.path, chapters.start, chapters.title from files "
+            "left join chapters on chapters.file_id = files.key where files.book_id = ? "
+            "order by files.track_number, files.path, chapters.start";
+        std::vector<BookChapters::Chapter> chapters;
+        sqlite3pp::query                   query(_libraryDb, kSelectChapters);
+        query.bind(1, (long long)bookId);
+        int64_t fileId    = -1;
+        size_t  fileIndex = 0;
+        for (auto row : query)
+        {
+            int64_t rowFileId = row.get<long long>(0);
+            if (fileId >= 0 && rowFileId != fileId)
+            {
+                ++fileIndex;
+            }
+            fileId = rowFileId;
+
+            BookChapters::Chapter chapter;
+            if (row.column_type(2) == SQLITE_NULL)
+            {
+                chapter.start = timeline.fileStart(fileIndex);
+                chapter.title = fs::path(row.get<char const*>(1)).stem().string();
+            }
+            else
+            {
+                chapter.start = timeline.bookPosition(fileIndex, row.get<long long>(2));
+                chapter.title = ValueOrEmpty(row.get<char const*>(3));
+            }
+            chapters.emplace_back(std::move(chapter));
+        }
+        return BookChapters(std::move(chapters));
+    }
+
+    // In the order of readBookFiles(), empty for files not analyzed yet
+    std::vector<Waveform> readBookWaveforms(uint32_t bookId)
+    {
+        static const char* const kSelectWaveforms =
+            "select waveforms.peaks from files left join waveforms on waveforms.file_id = files.key "
+            "where files.book_id = ? order by files.track_number, files.path";
+        std::vector<Waveform> waveforms;
+        sqlite3pp::query      query(_libraryDb, kSelectWaveforms);
+        query.bind(1, (long long)bookId);
+        for (auto row : query)
+        {
+            waveforms.emplace_back(Waveform::decode(row.get<void const*>(0), size_t(row.column_bytes(0))));
+        }
+        return waveforms;
+    }
+
+    // Brings the file to the target loudness within limits, never pushing its true peak over the ceiling
+    static float normalizationGain(double loudness, double truePeak)
+    {
+        double gainDb = std::clamp(kTargetLoudness - loudness, -kMaxNormalizationGainDb, kMaxNormalizationGainDb);
+        gainDb        = std::min(gainDb, kMaxTruePeak - truePeak);
+        return float(std::pow(10., gainDb / 20.));
     }
 
-    void readLibraryFromDb()
+    std::string readSetting(const std::string& setting, const std::string& defaultValue = {})
     {
-        _books.clear();
-        sqlite3pp::query query(_libraryDb, "select * from books");
-        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i)
+        sqlite3pp::query query(_libraryDb, "select value from settings where setting = ?");
+        query.bind(1, setting, sqlite3pp::nocopy);
+        for (auto row : query)
         {
-            Book book;
-            std::tie(book.id, book.duration, book.author, book.name, book.series, book.description, book.folder,
-                     book.thumbnailLocation) =
-                (*i).get_columns<long, long long, char const*, char const*, char const*, char const*, char const*,
-                                 char const*>(0, 1, 2, 3, 4, 5, 6, 7);
-            if (!book.thumbnailLocation.empty())
-            {
-                book.thumbnail = loadImage(book.thumbnailLocation);
-            }
+            return ValueOrEmpty(row.get<char const*>(0));
+        }
+        return defaultValue;
+    }
 
-            if (!book.thumbnail.handle)
-            {
-                book.thumbnail = _genericCover;
-            }
+    // written asynchronously by the writer thread
+    void writeSetting(const std::string& setting, const std::string& value)
+    {
+        _writer.writeSetting(setting, value);
+    }
 
-            _books.emplace_back(book);
-        }
+    void setDefaultSettings()
+    {
+        // removeFrom database
+        _writer.execute("delete from settings");
     }
 
 };  // struct Library
@@ -663,13 +2872,30 @@ struct AudiobookPlayerImpl
     using SM = StateMachine<PlayerState>;
 
     libvlc_instance_t*                          _vlcInstance {nullptr};
-    libvlc_media_player_t*                      _mediaPlayer {nullptr};
-    libvlc_media_t*                             _currentMedia {nullptr};
     SM                                          _stateMachine;
     Library                                     _library;
     std::unique_ptr<Book>                       _currentBook;
     std::string                                 _status;
     std::unordered_map<hq::StringHash, ImFont*> _fonts;
+    LibraryView                                 _libraryView {LibraryView::List};
+    size_t                                      _selectedBookIndex {0};
+    char                                        _searchText[256] {};
+    std::vector<Book>                           _searchResults;
+    uint64_t                                    _searchVersion {0};
+    bool                                        _openSelectedBook {false};
+    AudioPipeline                               _audio;  // outlives the players feeding it
+    BookPlayback                                _playback;
+    std::optional<float>                        _seekSeconds;  // while the progress bar is dragged
+    std::chrono::steady_clock::time_point       _lastCheckpoint;
+    float                                       _speed {kDefaultSpeed};
+    bool                                        _skipSilence {false};
+    float                                       _maxPauseSeconds {kDefaultMaxPauseMs / 1000.f};
+    bool                                        _normalize {true};
+    BookChapters                                _chapters;
+    std::vector<Waveform>                       _waveforms;  // per file of the current book, empty until analyzed
+    uint64_t                                    _waveformsVersion {0};
+    int64_t                                     _scrubberStart {0};  // first position shown, ms in the book
+    float                                       _scrubberZoom {1.f};  // shows the book's duration divided by it
 
     AudiobookPlayerImpl::AudiobookPlayerImpl()
         : _stateMachine(
@@ -702,6 +2928,9 @@ struct AudiobookPlayerImpl
 
     AudiobookPlayerImpl::~AudiobookPlayerImpl()
     {
+        // written by the library writer before it stops
+        checkpoint();
+        _library.stopAnalysis();
         if (_vlcInstance)
         {
             libvlc_release(_vlcInstance);
@@ -722,6 +2951,24 @@ struct AudiobookPlayerImpl
         {
             return false;
         }
+        // without an output device libVLC may still find one of its own
+        bool useAudioPipeline = _library.readSetting(kSettingAudioOutput) != kAudioOutputVlc && _audio.init();
+        if (!_playback.init(_vlcInstance, useAudioPipeline ? &_audio : nullptr))
+        {
+            return false;
+        }
+        _skipSilence     = _library.readSetting(kSettingSkipSilence) == kSettingOn;
+        _maxPauseSeconds = std::stoll(_library.readSetting(kSettingMaxPauseMs, std::to_string(kDefaultMaxPauseMs))) /
+                           1000.f;
+        applySilenceSkip();
+        _normalize = _library.readSetting(kSettingNormalize, kSettingOn) == kSettingOn;
+        if (_audio.isOpen())
+        {
+            _audio.setNormalization(_normalize);
+        }
+        _libraryView =
+            _library.readSetting(kSettingLibraryView) == kLibraryViewGrid ? LibraryView::Grid : LibraryView::List;
+        restoreLastBook();
 
         _status = kInitialized;
         return true;
@@ -743,37 +2990,382 @@ struct AudiobookPlayerImpl
         return true;
     }
 
-    bool openMedia(const std::string& path)
+    void update()
     {
-        assert(_vlcInstance);
+        _library.update();
+        _playback.update();
+        _library.setAnalysisThrottled(_playback.isPlaying());
+        if (_playback.isPlaying() && std::chrono::steady_clock::now() - _lastCheckpoint >= kCheckpointInterval)
+        {
+            checkpoint();
+        }
+        drawToolbar();
+        _stateMachine.tick();
+        drawStatus();
+    }
+
+    void setWakeCallback(std::function<void()> wake)
+    {
+        _library.setWakeCallback(wake);
+        _playback.setWakeCallback(std::move(wake));
+    }
 
-        _currentMedia = libvlc_media_new_path(_vlcInstance, path.c_str());
-        if (!_currentMedia)
+    // Nothing on screen changes on its own unless something animates or background work is waiting for update()
+    double idleTimeout()
+    {
+        if (_stateMachine.currentState() == PlayerState::LibraryDiscovery || _library.needsUpdate())
         {
-            return false;
+            return 0;
+        }
+        if (_playback.isPlaying())
+        {
+            return kPlayingRedrawInterval;
+        }
+        if (ui::GetIO().WantTextInput)
+        {
+            // text cursor blink
+            return kTextInputRedrawInterval;
         }
+        return std::numeric_limits<double>::infinity();
+    }
 
-        _mediaPlayer = libvlc_media_player_new_from_media(_currentMedia);
-        libvlc_media_release(_currentMedia);
+    // Opens the book where it was left
+    bool openBook(const Book& book, bool paused = false)
+    {
+        checkpoint();
 
-        libvlc_media_player_play(_mediaPlayer);
+        std::vector<PlaybackFile> files      = _library.readBookFiles(book.id);
+        BookTimeline::Location    resumeFrom = _library.readResumePoint(book.id, files);
+        if (!_playback.open(std::move(files), resumeFrom, paused))
+        {
+            _status = "Failed to open " + book.name;
+            return false;
+        }
+        _currentBook = std::make_unique<Book>(book);
+        _library.writeSetting(kSettingLastBookId, std::to_string(book.id));
 
+        float defaultSpeed = std::strtof(_library.readSetting(kPlayingSpeed).c_str(), nullptr);
+        if (defaultSpeed <= 0.f)
+        {
+            defaultSpeed = kDefaultSpeed;
+        }
+        _speed = snapSpeed(std::clamp(_library.readBookSpeed(book.id).value_or(defaultSpeed), kMinSpeed, kMaxSpeed));
+        _playback.setSpeed(_speed);
+
+        _chapters         = _library.readBookChapters(book.id, _playback.timeline());
+        _waveforms        = _library.readBookWaveforms(book.id);
+        _waveformsVersion = _library.analysisVersion();
+        _scrubberStart    = 0;
+        _scrubberZoom     = 1.f;
         return true;
     }
 
-    void update()
+    // Reads the book's waveforms again while some are missing and the analysis got further
+    void refreshWaveforms()
     {
-        drawToolbar();
-        _stateMachine.tick();
-        drawStatus();
+        uint64_t version = _library.analysisVersion();
+        if (version == _waveformsVersion)
+        {
+            return;
+        }
+        _waveformsVersion = version;
+
+        auto isMissing = [](const Waveform& waveform) { return waveform.empty(); };
+        if (_waveforms.size() != _playback.fileCount() ||
+            std::any_of(_waveforms.begin(), _waveforms.end(), isMissing))
+        {
+            _waveforms = _library.readBookWaveforms(_currentBook->id);
+        }
+    }
+
+    // Peak of a stretch of the book, merged across the files it spans
+    std::optional<WaveformPeak> waveformPeak(int64_t start, int64_t end) const
+    {
+        const BookTimeline&         timeline = _playback.timeline();
+        size_t                      count    = std::min(timeline.fileCount(), _waveforms.size());
+        std::optional<WaveformPeak> result;
+        for (size_t i = timeline.locate(start).fileIndex; i < count && timeline.fileStart(i) < end; ++i)
+        {
+            int64_t                     fileStart = timeline.fileStart(i);
+            std::optional<WaveformPeak> peak      = _waveforms[i].range(start - fileStart, end - fileStart);
+            if (peak && result)
+            {
+                result->min = std::min(result->min, peak->min);
+                result->max = std::max(result->max, peak->max);
+            }
+            else if (peak)
+            {
+                result = peak;
+            }
+        }
+        return result;
+    }
+
+    // Whole book progress over its waveform, one peak per pixel column looked up in the files' pyramids. The wheel
+    // zooms around the mouse, clicking or dragging seeks when released so dragging doesn't switch files all the way.
+    void drawScrubber()
+    {
+        refreshWaveforms();
+
+        int64_t duration = std::max<int64_t>(_playback.duration(), 1);
+        ImVec2  origin   = ui::GetCursorScreenPos();
+        ImVec2  size(std::max(ui::GetContentRegionAvail().x, 1.f), kScrubberHeight);
+        ui::InvisibleButton("##scrubber", size);
+
+        int64_t span  = std::max<int64_t>(int64_t(duration / _scrubberZoom), 1);
+        float   wheel = ui::GetIO().MouseWheel;
+        if (ui::IsItemHovered() && wheel != 0.f)
+        {
+            float   fraction = (ui::GetMousePos().x - origin.x) / size.x;
+            int64_t anchor   = _scrubberStart + int64_t(fraction * span);
+            float   maxZoom  = std::max(1.f, float(duration) / float(kMinScrubberSpanMs));
+            _scrubberZoom    = std::clamp(_scrubberZoom * std::pow(kScrubberZoomStep, wheel), 1.f, maxZoom);
+            span             = std::max<int64_t>(int64_t(duration / _scrubberZoom), 1);
+            _scrubberStart   = anchor - int64_t(fraction * span);
+        }
+
+        if (ui::IsItemActive())
+        {
+            float fraction = std::clamp((ui::GetMousePos().x - origin.x) / size.x, 0.f, 1.f);
+            _seekSeconds   = float(_scrubberStart + int64_t(fraction * span)) / 1000.f;
+        }
+        else if (_seekSeconds)
+        {
+            seek(int64_t(*_seekSeconds * 1000));
+            _seekSeconds.reset();
+        }
+
+        int64_t position = _seekSeconds ? int64_t(*_seekSeconds * 1000) : _playback.bookPosition();
+        if (!ui::IsItemHovered() && (position < _scrubberStart || position >= _scrubberStart + span))
+        {
+            // follows playback a page at a time, unless the mouse is looking around
+            _scrubberStart = position;
+        }
+        _scrubberStart = std::clamp<int64_t>(_scrubberStart, 0, duration - span);
+
+        ImDrawList* drawList   = ui::GetWindowDrawList();
+        ImU32       played     = ui::GetColorU32(ImGuiCol_PlotHistogram);
+        ImU32       ahead      = ui::GetColorU32(ImGuiCol_PlotLines);
+        float       middle     = origin.y + size.y / 2.f;
+        float       peakHeight = size.y / 2.f / Waveform::kPeakScale;
+        int64_t     columns    = int64_t(size.x);
+        drawList->AddRectFilled(origin, origin + size, ui::GetColorU32(ImGuiCol_FrameBg));
+        for (int64_t column = 0; column < columns; ++column)
+        {
+            int64_t                     start = _scrubberStart + span * column / columns;
+            std::optional<WaveformPeak> peak  = waveformPeak(start, _scrubberStart + span * (column + 1) / columns);
+            if (!peak)
+            {
+                continue;
+            }
+            float x = origin.x + float(column) + 0.5f;
+            ImVec2 top(x, middle - peak->max * peakHeight);
+            ImVec2 bottom(x, middle - peak->min * peakHeight + 1.f);
+            drawList->AddLine(top, bottom, start < position ? played : ahead);
+        }
+        // chapter starts as ticks along the top
+        ImU32 tick = ui::GetColorU32(ImGuiCol_TextDisabled);
+        for (size_t i = _chapters.firstFrom(_scrubberStart);
+             i < _chapters.count() && _chapters[i].start < _scrubberStart + span; ++i)
+        {
+            float x = origin.x + float(_chapters[i].start - _scrubberStart) * size.x / float(span);
+            drawList->AddLine(ImVec2(x, origin.y), ImVec2(x, origin.y + size.y / 4.f), tick);
+        }
+
+        float cursorX = origin.x + float(position - _scrubberStart) * size.x / float(span);
+        drawList->AddLine(ImVec2(cursorX, origin.y), ImVec2(cursorX, origin.y + size.y),
+                          ui::GetColorU32(ImGuiCol_Text));
+    }
+
+    void applySilenceSkip()
+    {
+        if (_audio.isOpen())
+        {
+            _audio.setSilenceSkip(_skipSilence, int64_t(_maxPauseSeconds * 1000));
+        }
+    }
+
+    // Seeks the whole book, the resume point follows right away
+    void seek(int64_t position)
+    {
+        _playback.seek(position);
+
+        // the player reports the new position only once the seek went through
+        BookTimeline::Location location = _playback.timeline().locate(position);
+        checkpoint(location.fileIndex, location.offset);
+    }
+
+    // Current chapter with a list to jump to any other and buttons for the neighbours
+    void drawChapters()
+    {
+        if (_chapters.empty())
+        {
+            return;
+        }
+
+        int64_t position = _playback.bookPosition();
+        size_t  current  = _chapters.indexAt(position);
+        if (ui::Button("<"))
+        {
+            bool restart = position - _chapters[current].start > kChapterRestartMs || current == 0;
+            seek(_chapters[restart ? current : current - 1].start);
+        }
+        ui::SameLine();
+        if (ui::Button(">") && current + 1 < _chapters.count())
+        {
+            seek(_chapters[current + 1].start);
+        }
+
+        ui::SameLine();
+        ui::SetNextItemWidth(-1);
+        std::string preview = std::to_string(current + 1) + " / " + std::to_string(_chapters.count()) + "  " +
+                              _chapters[current].title;
+        if (ui::BeginCombo("##chapters", preview.c_str()))
+        {
+            ImGuiListClipper clipper;
+            clipper.Begin(int(_chapters.count()));
+            while (clipper.Step())
+            {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+                {
+                    const BookChapters::Chapter& chapter = _chapters[size_t(i)];
+                    ui::PushID(i);
+                    if (ui::Selectable(chapter.title.empty() ? "-" : chapter.title.c_str(), size_t(i) == current))
+                    {
+                        seek(chapter.start);
+                    }
+                    ui::PopID();
+                }
+            }
+            clipper.End();
+            ui::EndCombo();
+        }
+    }
+
+    // Dragging hardly ever stops exactly on 1, close enough plays at the normal speed without stretching
+    static float snapSpeed(float speed)
+    {
+        return std::abs(speed - kDefaultSpeed) < kSpeedSnap ? kDefaultSpeed : speed;
+    }
+
+    // Remembered for the book and as the default for books not played yet
+    void drawSpeed()
+    {
+        ui::SetNextItemWidth(150.f);
+        if (ui::SliderFloat("Speed", &_speed, kMinSpeed, kMaxSpeed, "%.2fx"))
+        {
+            _speed = snapSpeed(_speed);
+            _playback.setSpeed(_speed);
+        }
+        if (ui::IsItemDeactivatedAfterEdit())
+        {
+            _library.writeBookSpeed(_currentBook->id, _speed);
+            _library.writeSetting(kPlayingSpeed, std::to_string(_speed));
+        }
+    }
+
+    void drawSilenceSkip()
+    {
+        if (ui::Checkbox("Skip silence", &_skipSilence))
+        {
+            applySilenceSkip();
+            _library.writeSetting(kSettingSkipSilence, _skipSilence ? kSettingOn : std::string());
+        }
+        if (!_skipSilence)
+        {
+            return;
+        }
+
+        ui::SameLine();
+        ui::SetNextItemWidth(150.f);
+        if (ui::SliderFloat("Longest pause", &_maxPauseSeconds, kMinMaxPauseSeconds, kMaxMaxPauseSeconds, "%.1f s"))
+        {
+            applySilenceSkip();
+        }
+        if (ui::IsItemDeactivatedAfterEdit())
+        {
+            _library.writeSetting(kSettingMaxPauseMs, std::to_string(int64_t(_maxPauseSeconds * 1000)));
+        }
+    }
+
+    // Evens out the loudness of the book's files once they were analyzed
+    void drawNormalize()
+    {
+        if (ui::Checkbox("Normalize volume", &_normalize))
+        {
+            _audio.setNormalization(_normalize);
+            _library.writeSetting(kSettingNormalize, _normalize ? kSettingOn : std::string());
+        }
+    }
+
+    void restoreLastBook()
+    {
+        std::string lastBookId = _library.readSetting(kSettingLastBookId);
+        if (lastBookId.empty())
+        {
+            return;
+        }
+        std::optional<Book> book = _library.loadBook(uint32_t(std::stoul(lastBookId)));
+        if (book)
+        {
+            openBook(*book, true);
+        }
+    }
+
+    // Queues the current position as the book's resume point, the writer thread does the I/O
+    void checkpoint()
+    {
+        if (_currentBook && _playback.isOpen())
+        {
+            checkpoint(_playback.fileIndex(), _playback.position());
+        }
+    }
+
+    void checkpoint(size_t fileIndex, int64_t position)
+    {
+        _library.writeCheckpoint(_currentBook->id, _playback.filePath(fileIndex), position);
+        _lastCheckpoint = std::chrono::steady_clock::now();
     }
 
     void drawToolbar()
     {
         ui::Text("Toolbar here...");
+        if (_stateMachine.currentState() == PlayerState::Library && _currentBook)
+        {
+            ui::SameLine();
+            if (ui::Button("Now playing"))
+            {
+                _stateMachine.changeState(PlayerState::Player);
+            }
+        }
+        if (_stateMachine.currentState() == PlayerState::Library && !_library._libraryPath.empty())
+        {
+            ui::SameLine();
+            if (ui::Button("Rescan library") &&
+                _library.startLibraryDiscovery(_library._libraryPath, Library::DiscoveryMode::Incremental))
+            {
+                _stateMachine.changeState(PlayerState::LibraryDiscovery);
+            }
+            ui::SameLine();
+            if (ui::RadioButton("List", _libraryView == LibraryView::List))
+            {
+                setLibraryView(LibraryView::List);
+            }
+            ui::SameLine();
+            if (ui::RadioButton("Grid", _libraryView == LibraryView::Grid))
+            {
+                setLibraryView(LibraryView::Grid);
+            }
+        }
         ui::Separator();
     }
 
+    void setLibraryView(LibraryView view)
+    {
+        _libraryView = view;
+        _library.writeSetting(kSettingLibraryView, view == LibraryView::Grid ? kLibraryViewGrid : kLibraryViewList);
+    }
+
     void drawStatus()
     {
         ui::SetCursorPosX(0);
@@ -850,9 +3442,7 @@ struct AudiobookPlayerImpl
 
         return {};
     }
-    void onExitLibraryDiscovery() {
-        _library.readLibraryFromDb();
-    }
+    void onExitLibraryDiscovery() { }
 
     // PlayerState::LibraryParsing
     void onEnterLibraryParsing() { }
@@ -869,40 +3459,185 @@ struct AudiobookPlayerImpl
     {
         return {};
     }
+    bool isSearching() const
+    {
+        return _searchText[0] != 0;
+    }
+
+    // The library views show either the whole library or the search results
+    size_t bookCount()
+    {
+        return isSearching() ? _searchResults.size() : _library._books.size();
+    }
+
+    const Book* bookAt(size_t index)
+    {
+        if (isSearching())
+        {
+            return index < _searchResults.size() ? &_searchResults[index] : nullptr;
+        }
+        return _library._books.bookAt(index);
+    }
+
+    void prefetchBooks(size_t firstIndex, size_t lastIndex)
+    {
+        if (!isSearching())
+        {
+            _library._books.prefetch(firstIndex, lastIndex);
+        }
+    }
+
+    // Searches again on every edit and whenever the library changed under the results
+    void drawSearch(float width)
+    {
+        ui::SetNextItemWidth(width);
+        bool edited = ui::InputTextWithHint("##search", "Search title, author, series...", _searchText,
+                                            sizeof(_searchText));
+        if (edited || (isSearching() && _searchVersion != _library._booksVersion))
+        {
+            _searchResults     = _library.search(_searchText, kMaxSearchResults);
+            _searchVersion     = _library._booksVersion;
+            _selectedBookIndex = 0;
+        }
+    }
+
+    // Only the visible rows are submitted and asked for, pages outside the view are never loaded. Every row has
+    // the same height whether its book is loaded yet or not, the clipper relies on it.
+    void drawBookList()
+    {
+        ImGuiListClipper clipper;
+        int              firstVisible = 0;
+        int              lastVisible  = 0;
+        clipper.Begin(int(bookCount()), ui::GetTextLineHeightWithSpacing());
+        while (clipper.Step())
+        {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+            {
+                const Book* book = bookAt(size_t(i));
+                ui::PushID(i);
+                if (ui::Selectable(book ? book->name.c_str() : "...", size_t(i) == _selectedBookIndex,
+                                   ImGuiSelectableFlags_AllowDoubleClick))
+                {
+                    _selectedBookIndex = size_t(i);
+                    _openSelectedBook  = ui::IsMouseDoubleClicked(0);
+                }
+                ui::PopID();
+            }
+            firstVisible = clipper.DisplayStart;
+            lastVisible  = std::max(clipper.DisplayEnd - 1, firstVisible);
+        }
+        clipper.End();
+        prefetchBooks(size_t(firstVisible), size_t(lastVisible));
+    }
+
+    // Same virtualization as the list, the clipper walks rows of covers
+    void drawBookGrid(float width)
+    {
+        const ImGuiStyle& style       = ui::GetStyle();
+        const float       cellHeight  = kCoverGridCellSize + ui::GetTextLineHeight();
+        const size_t      bookCount   = this->bookCount();
+        const float       usableWidth = width - style.ScrollbarSize + style.ItemSpacing.x;
+        const int         columns     = std::max(1, int(usableWidth / (kCoverGridCellSize + style.ItemSpacing.x)));
+        const int         rows        = int((bookCount + columns - 1) / columns);
+
+        ImDrawList*      drawList = ui::GetWindowDrawList();
+        ImGuiListClipper clipper;
+        size_t           firstVisible = 0;
+        size_t           lastVisible  = 0;
+        clipper.Begin(rows, cellHeight + style.ItemSpacing.y);
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+            {
+                for (int column = 0; column < columns; ++column)
+                {
+                    size_t index = size_t(row) * columns + column;
+                    if (index >= bookCount)
+                    {
+                        break;
+                    }
+                    if (column > 0)
+                    {
+                        ui::SameLine();
+                    }
+
+                    ImVec2 cellPos = ui::GetCursorScreenPos();
+                    ui::PushID(int(index));
+                    if (ui::Selectable("##cover", index == _selectedBookIndex, ImGuiSelectableFlags_AllowDoubleClick,
+                                       ImVec2(kCoverGridCellSize, cellHeight)))
+                    {
+                        _selectedBookIndex = index;
+                        _openSelectedBook  = ui::IsMouseDoubleClicked(0);
+                    }
+                    ui::PopID();
+
+                    const Book* book = bookAt(index);
+                    if (!book)
+                    {
+                        continue;
+                    }
+                    const TextureRegion& cover = _library.cover(*book);
+                    ImVec2 imageSpace(kCoverGridCellSize, kCoverGridCellSize);
+                    ImVec2 imageSize = scaleToFit(cover.aspectRatio, imageSpace);
+                    ImVec2 imagePos  = cellPos + (imageSpace - imageSize) / 2;
+                    drawList->AddImage((void*)(intptr_t)cover.handle, imagePos, imagePos + imageSize, cover.uv0,
+                                       cover.uv1);
+
+                    ImVec2 textPos(cellPos.x, cellPos.y + kCoverGridCellSize);
+                    drawList->PushClipRect(textPos, textPos + ImVec2(kCoverGridCellSize, ui::GetTextLineHeight()),
+                                           true);
+                    drawList->AddText(textPos, ui::GetColorU32(ImGuiCol_Text), book->name.c_str());
+                    drawList->PopClipRect();
+                }
+            }
+            firstVisible = size_t(clipper.DisplayStart) * columns;
+            lastVisible  = std::min(size_t(clipper.DisplayEnd) * columns, bookCount);
+            lastVisible  = std::max(lastVisible, firstVisible + 1) - 1;
+        }
+        clipper.End();
+        prefetchBooks(firstVisible, lastVisible);
+    }
+
     SM::ResultType onUpdateLibrary()
     {
-        static size_t selectedIndex = 0;
-        float         listBoxHeight = ui::GetWindowHeight() - 2 * ui::GetCursorPosY();
-        float         listBoxWidth  = ui::GetWindowWidth() / 2 - ui::GetStyle().FramePadding.x;
+        float listBoxWidth = ui::GetWindowWidth() / 2 - ui::GetStyle().FramePadding.x;
+        drawSearch(listBoxWidth);
+        float listBoxHeight = ui::GetWindowHeight() - 2 * ui::GetCursorPosY();
         if (ui::BeginChild("content"))
         {
             ui::Columns(2);
             if (ui::ListBoxHeader("##", ImVec2(listBoxWidth, listBoxHeight)))
             {
-                int count = 0;
-                for (const auto& book : _library._books)
+                if (_libraryView == LibraryView::Grid)
                 {
-                    if (ui::Selectable(book.name.c_str(), count == selectedIndex, ImGuiSelectableFlags_AllowDoubleClick))
-                    {
-                        selectedIndex = count;
-                    }
-                    count++;
+                    drawBookGrid(listBoxWidth);
+                }
+                else
+                {
+                    drawBookList();
                 }
                 ui::ListBoxFooter();
-                if (selectedIndex >= _library._books.size())
+                if (_selectedBookIndex >= bookCount())
                 {
-                    selectedIndex = 0;
+                    _selectedBookIndex = 0;
                 }
             }
             ui::NextColumn();
-            const Book& selectedBook = _library._books[selectedIndex];
-            if (selectedBook.thumbnail.handle)
+            const Book* selectedBookPtr = bookAt(_selectedBookIndex);
+            if (!selectedBookPtr)
+            {
+                ui::EndChild();
+                return {};
+            }
+            const Book& selectedBook = *selectedBookPtr;
+            const TextureRegion& cover = _library.cover(selectedBook);
+            if (cover.handle)
             {
                 ImVec2 imageSpace(listBoxWidth, listBoxHeight / 2.f);
-                ImVec2 imageSize = scaleToFit(selectedBook.thumbnail.aspectRatio, imageSpace);
+                ImVec2 imageSize = scaleToFit(cover.aspectRatio, imageSpace);
                 ImVec2 cursorPos = ui::GetCursorPos();
                 ui::SetCursorPos(cursorPos + (imageSpace - imageSize) / 2);
-                ui::Image((void*)(intptr_t)selectedBook.thumbnail.handle, imageSize);
+                ui::Image((void*)(intptr_t)cover.handle, imageSize, cover.uv0, cover.uv1);
             }
 
             ui::NewLine();
@@ -923,6 +3658,15 @@ struct AudiobookPlayerImpl
             ui::EndChild();
         }
 
+        if (_openSelectedBook)
+        {
+            _openSelectedBook        = false;
+            const Book* selectedBook = bookAt(_selectedBookIndex);
+            if (selectedBook && openBook(*selectedBook))
+            {
+                return PlayerState::Player;
+            }
+        }
         return {};
     }
     void onExitLibrary() { }
@@ -939,6 +3683,54 @@ struct AudiobookPlayerImpl
     }
     SM::ResultType onUpdatePlayer()
     {
+        if (!_currentBook)
+        {
+            return PlayerState::Library;
+        }
+
+        ui::PushFont(_fonts[kFontTitle]);
+        ui::Text(_currentBook->name.c_str());
+        ui::PopFont();
+        ui::Text(_currentBook->author.c_str());
+
+        int64_t positionSeconds = _playback.bookPosition() / 1000;
+        int64_t durationSeconds = _playback.duration() / 1000;
+        ui::Text("File %d / %d  %02d:%02d:%02d / %02d:%02d:%02d", int(_playback.fileIndex() + 1),
+                 int(_playback.fileCount()), int(positionSeconds / 3600), int(positionSeconds / 60 % 60),
+                 int(positionSeconds % 60), int(durationSeconds / 3600), int(durationSeconds / 60 % 60),
+                 int(durationSeconds % 60));
+
+        drawChapters();
+        drawScrubber();
+
+        if (ui::Button(_playback.isPlaying() ? "Pause" : "Play"))
+        {
+            if (_playback.isPlaying())
+            {
+                _playback.pause();
+                checkpoint();
+            }
+            else
+            {
+                _playback.play();
+            }
+        }
+        ui::SameLine();
+        if (ui::Button("Library"))
+        {
+            return PlayerState::Library;
+        }
+
+        ui::SameLine();
+        drawSpeed();
+
+        // only the pipeline sees the samples
+        if (_audio.isOpen())
+        {
+            drawNormalize();
+            ui::SameLine();
+            drawSilenceSkip();
+        }
         return {};
     }
     void onExitPlayer() { }
@@ -956,6 +3748,16 @@ void AudiobookPlayer::update()
     _impl->update();
 }
 
+void AudiobookPlayer::setWakeCallback(std::function<void()> wake)
+{
+    _impl->setWakeCallback(std::move(wake));
+}
+
+double AudiobookPlayer::idleTimeout() const
+{
+    return _impl->idleTimeout();
+}
+
 bool AudiobookPlayer::init(int argc, const char* const* argv)
 {
     return _impl->init(argc, argv);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <functional>
 #include <mutex>
 #include <memory>
 
@@ -15,6 +16,11 @@ public:
 
     void update();
 
+    // Called from background threads when the player needs a frame while the main loop waits for events
+    void setWakeCallback(std::function<void()> wake);
+    // Seconds until the next frame is needed without any input, 0 to keep drawing, infinity when idle
+    double idleTimeout() const;
+
     bool init(int argc , const char *const *argv);
 
 private:
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The chapters of a whole book sorted by where they start in it, so finding the chapter of a position, or the
+// chapters within a stretch of the book, is a binary search. Positions in ms, like BookTimeline.
+class BookChapters
+{
+public:
+    struct Chapter
+    {
+        int64_t     start {0};  // in the book
+        std::string title;
+    };
+
+    BookChapters() = default;
+
+    explicit BookChapters(std::vector<Chapter> chapters)
+        : _chapters(std::move(chapters))
+    {
+        std::stable_sort(_chapters.begin(), _chapters.end(),
+                         [](const Chapter& a, const Chapter& b) { return a.start < b.start; });
+    }
+
+    size_t count() const
+    {
+        return _chapters.size();
+    }
+
+    bool empty() const
+    {
+        return _chapters.empty();
+    }
+
+    const Chapter& operator[](size_t index) const
+    {
+        return _chapters[index];
+    }
+
+    // The chapter playing at the position, the first one for positions before it
+    size_t indexAt(int64_t position) const
+    {
+        auto next = std::upper_bound(_chapters.begin(), _chapters.end(), position,
+                                     [](int64_t value, const Chapter& chapter) { return value < chapter.start; });
+        return next == _chapters.begin() ? 0 : size_t(next - _chapters.begin()) - 1;
+    }
+
+    // First chapter starting at or after the position, count() if there is none
+    size_t firstFrom(int64_t position) const
+    {
+        auto first = std::lower_bound(_chapters.begin(), _chapters.end(), position,
+                                      [](const Chapter& chapter, int64_t value) { return chapter.start < value; });
+        return size_t(first - _chapters.begin());
+    }
+
+private:
+    std::vector<Chapter> _chapters;
+};
@@ -0,0 +1,393 @@
+#include "BookPlayback.h"
+#include "vlc/vlc.h"
+#include <iostream>
+
+// LITERALS
+// input option, the file is opened and buffered but stays paused at its first frame
+static const char* const kStartPausedOption = ":start-paused";
+
+BookPlayback::~BookPlayback()
+{
+    for (auto& slot : _slots)
+    {
+        if (slot.player)
+        {
+            libvlc_media_player_stop(slot.player);
+            setMedia(slot, nullptr);
+            libvlc_media_player_release(slot.player);
+        }
+    }
+}
+
+bool BookPlayback::init(libvlc_instance_t* vlcInstance, AudioPipeline* audio)
+{
+    _vlcInstance = vlcInstance;
+    _audio       = audio;
+    for (auto& slot : _slots)
+    {
+        slot.owner  = this;
+        slot.player = libvlc_media_player_new(_vlcInstance);
+        if (!slot.player)
+        {
+            std::cout << "Failed to create media player" << std::endl;
+            return false;
+        }
+        if (_audio)
+        {
+            // one pipeline input per slot
+            _audio->attach(slot.player, slotIndex(slot));
+        }
+
+        libvlc_event_manager_t* eventManager = libvlc_media_player_event_manager(slot.player);
+        for (auto eventType : {libvlc_MediaPlayerEndReached, libvlc_MediaPlayerEncounteredError,
+                               libvlc_MediaPlayerPaused})
+        {
+            libvlc_event_attach(eventManager, eventType, &BookPlayback::onPlayerEvent, &slot);
+        }
+    }
+    return true;
+}
+
+void BookPlayback::setWakeCallback(std::function<void()> wake)
+{
+    _wake = std::move(wake);
+}
+
+bool BookPlayback::open(std::vector<PlaybackFile> files, BookTimeline::Location from, bool paused)
+{
+    close();
+    if (from.fileIndex >= files.size())
+    {
+        return false;
+    }
+
+    std::vector<int64_t> durations;
+    durations.reserve(files.size());
+    for (const auto& file : files)
+    {
+        durations.push_back(file.duration);
+    }
+    _files    = std::move(files);
+    _timeline = BookTimeline(durations);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        setActive(0);
+    }
+
+    if (!start(_slots[0], from.fileIndex, from.offset, paused))
+    {
+        close();
+        return false;
+    }
+    if (paused)
+    {
+        // opened paused to be resumed by play(), not a preroll
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slots[0].prerolling = false;
+    }
+    preroll(_slots[1], from.fileIndex + 1);
+    return true;
+}
+
+void BookPlayback::seek(int64_t bookPositionMs)
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    BookTimeline::Location location = _timeline.locate(bookPositionMs);
+    Slot&                  active   = _slots[_active];
+    if (location.fileIndex == fileIndex())
+    {
+        if (_audio)
+        {
+            _audio->seekStream(_active, location.offset);
+        }
+        libvlc_media_player_set_time(active.player, location.offset);
+        return;
+    }
+
+    bool paused = !libvlc_media_player_is_playing(active.player);
+    start(active, location.fileIndex, location.offset, paused);
+    {
+        // a paused seek must not turn into a preroll
+        std::lock_guard<std::mutex> lock(_mutex);
+        active.prerolling = false;
+        active.prerolled  = false;
+    }
+    preroll(_slots[1 - _active], location.fileIndex + 1);
+}
+
+void BookPlayback::close()
+{
+    for (auto& slot : _slots)
+    {
+        stop(slot);
+        setMedia(slot, nullptr);
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.prerolling = false;
+        slot.prerolled  = false;
+    }
+
+    // events of the stopped files are meaningless now
+    Event event;
+    while (_events.tryPop(event))
+    {
+    }
+    _files.clear();
+    _timeline = BookTimeline();
+}
+
+void BookPlayback::play()
+{
+    libvlc_media_player_t* player = _slots[_active].player;
+    if (libvlc_media_player_get_state(player) == libvlc_Paused)
+    {
+        libvlc_media_player_set_pause(player, 0);
+    }
+    else
+    {
+        libvlc_media_player_play(player);
+    }
+}
+
+void BookPlayback::pause()
+{
+    libvlc_media_player_set_pause(_slots[_active].player, 1);
+}
+
+void BookPlayback::setSpeed(float speed)
+{
+    if (_audio)
+    {
+        _audio->setSpeed(speed);
+        return;
+    }
+    for (auto& slot : _slots)
+    {
+        libvlc_media_player_set_rate(slot.player, speed);
+    }
+}
+
+bool BookPlayback::isOpen() const
+{
+    return !_files.empty();
+}
+
+bool BookPlayback::isPlaying() const
+{
+    return isOpen() && libvlc_media_player_is_playing(_slots[_active].player);
+}
+
+size_t BookPlayback::fileIndex() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _slots[_active].fileIndex;
+}
+
+int64_t BookPlayback::position() const
+{
+    return isOpen() ? std::max<int64_t>(libvlc_media_player_get_time(_slots[_active].player), 0) : 0;
+}
+
+int64_t BookPlayback::bookPosition() const
+{
+    return _timeline.bookPosition(fileIndex(), position());
+}
+
+void BookPlayback::update()
+{
+    Event event;
+    while (_events.tryPop(event))
+    {
+        switch (event)
+        {
+            case Event::Switched:
+            {
+                // the slot that just finished gets the file after the one now playing
+                size_t active = _active;
+                preroll(_slots[1 - active], _slots[active].fileIndex + 1);
+                break;
+            }
+            case Event::Ended:
+                advance();
+                break;
+            case Event::Error:
+                std::cout << "Playback failed: " << _files[fileIndex()].path << std::endl;
+                advance();
+                break;
+        }
+    }
+}
+
+// The playing file ended without the other slot being ready, slower path through a regular open
+void BookPlayback::advance()
+{
+    size_t nextIndex = fileIndex() + 1;
+    if (nextIndex >= _files.size())
+    {
+        return;
+    }
+
+    size_t finished = _active;
+    Slot&  next     = _slots[1 - finished];
+    bool   resumed  = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (next.fileIndex == nextIndex && next.prerolled)
+        {
+            // became ready after the end was reported
+            libvlc_media_player_set_pause(next.player, 0);
+            next.prerolled = false;
+            resumed        = true;
+        }
+        setActive(1 - finished);
+    }
+
+    if (!resumed && !start(next, nextIndex, 0, false))
+    {
+        return;
+    }
+    preroll(_slots[finished], nextIndex + 1);
+}
+
+void BookPlayback::setActive(size_t index)
+{
+    _active = index;
+    if (_audio)
+    {
+        _audio->setActiveInput(index);
+    }
+}
+
+void BookPlayback::stop(Slot& slot)
+{
+    libvlc_media_player_stop(slot.player);
+    if (_audio)
+    {
+        _audio->flush(slotIndex(slot));
+    }
+}
+
+bool BookPlayback::start(Slot& slot, size_t fileIndex, int64_t positionMs, bool paused)
+{
+    stop(slot);
+
+    libvlc_media_t* media = libvlc_media_new_path(_vlcInstance, _files[fileIndex].path.c_str());
+    if (!media)
+    {
+        return false;
+    }
+    if (positionMs > 0)
+    {
+        std::string startTime = ":start-time=" + std::to_string(positionMs / 1000.0);
+        libvlc_media_add_option(media, startTime.c_str());
+    }
+    if (paused)
+    {
+        libvlc_media_add_option(media, kStartPausedOption);
+    }
+
+    setMedia(slot, media);
+    if (_audio)
+    {
+        const PlaybackFile& file = _files[fileIndex];
+        _audio->startStream(slotIndex(slot), positionMs, file.silences, file.gain);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.fileIndex  = fileIndex;
+        slot.prerolling = paused;
+        slot.prerolled  = false;
+    }
+    return libvlc_media_player_play(slot.player) == 0;
+}
+
+// Takes over the caller's reference, the previous media is released once the player dropped it
+void BookPlayback::setMedia(Slot& slot, libvlc_media_t* media)
+{
+    libvlc_media_player_set_media(slot.player, media);
+    if (slot.media)
+    {
+        libvlc_media_release(slot.media);
+    }
+    slot.media = media;
+}
+
+void BookPlayback::preroll(Slot& slot, size_t fileIndex)
+{
+    if (fileIndex < _files.size())
+    {
+        start(slot, fileIndex, 0, true);
+    }
+    else
+    {
+        stop(slot);
+        setMedia(slot, nullptr);
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.prerolling = false;
+        slot.prerolled  = false;
+    }
+}
+
+// libVLC event thread. Functions of the player sending the event must not be called from here, the other
+// player's are fine.
+void BookPlayback::onPlayerEvent(const libvlc_event_t* event, void* userData)
+{
+    Slot*         slot = static_cast<Slot*>(userData);
+    BookPlayback& self = *slot->owner;
+    {
+        std::lock_guard<std::mutex> lock(self._mutex);
+        bool                        isActive = slot == &self._slots[self._active];
+        switch (event->type)
+        {
+            case libvlc_MediaPlayerPaused:
+                if (slot->prerolling)
+                {
+                    slot->prerolling = false;
+                    slot->prerolled  = true;
+                }
+                return;
+
+            case libvlc_MediaPlayerEncounteredError:
+                if (!isActive)
+                {
+                    // the next file failed to open, handled once it's its turn
+                    slot->prerolling = false;
+                    return;
+                }
+                self._events.push(Event::Error);
+                break;
+
+            case libvlc_MediaPlayerEndReached:
+            {
+                if (!isActive)
+                {
+                    return;
+                }
+                Slot& next = self._slots[1 - self._active];
+                if (next.prerolled && next.fileIndex == slot->fileIndex + 1)
+                {
+                    libvlc_media_player_set_pause(next.player, 0);
+                    next.prerolled = false;
+                    self.setActive(1 - self._active);
+                    self._events.push(Event::Switched);
+                }
+                else
+                {
+                    self._events.push(Event::Ended);
+                }
+                break;
+            }
+
+            default:
+                return;
+        }
+    }
+
+    if (self._wake)
+    {
+        self._wake();
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "AudioPipeline.h"
+#include "BookTimeline.h"
+#include "ConcurrentQueue.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct libvlc_instance_t;
+struct libvlc_media_player_t;
+struct libvlc_media_t;
+struct libvlc_event_t;
+
+struct PlaybackFile
+{
+    std::string                       path;
+    int64_t                           duration {0};  // ms
+    std::shared_ptr<const SilenceMap> silences;      // null until the file was analyzed
+    float                             gain {1.f};    // loudness normalization, linear
+};
+
+// Plays the files of a book back to back. Two media players take turns: while one plays file N the other already
+// opened file N + 1 and waits paused at its start. When the playing one reaches its end the waiting one is resumed
+// straight from the libVLC event, so there is no re-open between files, then the finished player is prepared with
+// the file after on the next update().
+// Both players live as long as the BookPlayback and only ever get new media, opening another book doesn't
+// tear down and re-create the audio output.
+class BookPlayback
+{
+public:
+    BookPlayback() = default;
+    ~BookPlayback();
+
+    // Plays through the pipeline if there is one, through libVLC's own output otherwise
+    bool init(libvlc_instance_t* vlcInstance, AudioPipeline* audio = nullptr);
+
+    // Called from libVLC threads when update() has work, e.g. after switching to the next file
+    void setWakeCallback(std::function<void()> wake);
+
+    // Starts the book at the given file and offset in it, paused there or playing
+    bool open(std::vector<PlaybackFile> files, BookTimeline::Location from = {}, bool paused = false);
+    void close();
+
+    // Jumps anywhere in the book, switches media only if the position is in another file
+    void seek(int64_t bookPositionMs);
+
+    void play();
+    void pause();
+    // Pitch preserving through the pipeline, plain libVLC rate change without it
+    void setSpeed(float speed);
+    bool isOpen() const;
+    bool isPlaying() const;
+
+    size_t fileIndex() const;
+    size_t fileCount() const
+    {
+        return _files.size();
+    }
+    const std::string& filePath(size_t fileIndex) const
+    {
+        return _files[fileIndex].path;
+    }
+    // Position inside the current file
+    int64_t position() const;
+    int64_t bookPosition() const;
+    int64_t duration() const
+    {
+        return _timeline.duration();
+    }
+    const BookTimeline& timeline() const
+    {
+        return _timeline;
+    }
+
+    // UI thread, once per frame
+    void update();
+
+private:
+    struct Slot
+    {
+        BookPlayback*          owner {nullptr};
+        libvlc_media_player_t* player {nullptr};
+        libvlc_media_t*        media {nullptr};  // owned, replaced by setMedia()
+        size_t                 fileIndex {0};
+        bool                   prerolling {false};  // opening fileIndex, pauses by itself at its start
+        bool                   prerolled {false};   // opened and paused at the start of fileIndex
+    };
+
+    enum class Event
+    {
+        Switched,  // the other slot took over, the finished one is free for the next file
+        Ended,     // nothing to switch to, either the last file ended or the next one wasn't ready
+        Error,
+    };
+
+    static void onPlayerEvent(const libvlc_event_t* event, void* userData);
+
+    static void setMedia(Slot& slot, libvlc_media_t* media);
+
+    size_t slotIndex(const Slot& slot) const
+    {
+        return size_t(&slot - _slots.data());
+    }
+    void setActive(size_t index);  // with _mutex held
+    void stop(Slot& slot);
+
+    bool start(Slot& slot, size_t fileIndex, int64_t positionMs, bool paused);
+    void preroll(Slot& slot, size_t fileIndex);
+    void advance();
+
+    libvlc_instance_t*        _vlcInstance {nullptr};
+    AudioPipeline*            _audio {nullptr};
+    std::array<Slot, 2>       _slots;
+    std::vector<PlaybackFile> _files;
+    BookTimeline              _timeline;
+    mutable std::mutex        _mutex;       // the slots' state, shared with the libVLC event threads
+    std::atomic<size_t>       _active {0};  // written under _mutex
+    ConcurrentQueue<Event>    _events;
+    std::function<void()>     _wake;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Maps positions in a whole book to positions in one of its files and back. Keeps the start of every file as a
+// prefix sum of the file durations, so both directions are a lookup or a binary search. Milliseconds throughout,
+// the resolution libVLC reports durations and seeks in.
+class BookTimeline
+{
+public:
+    struct Location
+    {
+        size_t  fileIndex {0};
+        int64_t offset {0};  // inside the file
+    };
+
+    BookTimeline() = default;
+
+    explicit BookTimeline(const std::vector<int64_t>& fileDurations)
+    {
+        _starts.reserve(fileDurations.size() + 1);
+        _starts.push_back(0);
+        for (int64_t duration : fileDurations)
+        {
+            _starts.push_back(_starts.back() + std::max<int64_t>(duration, 0));
+        }
+    }
+
+    size_t fileCount() const
+    {
+        return _starts.empty() ? 0 : _starts.size() - 1;
+    }
+
+    int64_t duration() const
+    {
+        return _starts.empty() ? 0 : _starts.back();
+    }
+
+    int64_t fileStart(size_t fileIndex) const
+    {
+        return _starts[std::min(fileIndex, fileCount())];
+    }
+
+    // Positions past the end land at the end of the last file. Files of unknown, 0, duration are skipped, a book
+    // without any known duration stays at the start of its first file.
+    Location locate(int64_t bookPosition) const
+    {
+        Location location;
+        if (fileCount() == 0 || duration() == 0)
+        {
+            return location;
+        }
+
+        bookPosition = std::clamp<int64_t>(bookPosition, 0, duration());
+        // first file ending after the position contains it
+        auto end           = std::upper_bound(_starts.begin() + 1, _starts.end(), bookPosition);
+        location.fileIndex = std::min(size_t(end - _starts.begin()) - 1, fileCount() - 1);
+        location.offset    = bookPosition - _starts[location.fileIndex];
+        return location;
+    }
+
+    int64_t bookPosition(size_t fileIndex, int64_t offset) const
+    {
+        return fileStart(fileIndex) + offset;
+    }
+
+private:
+    std::vector<int64_t> _starts;  // fileCount() + 1 entries, the last one is the book's duration
+};
@@ -0,0 +1,225 @@
+#include "ChapterReader.h"
+#include "Mp4Box.h"
+#include "TextEncoding.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+using namespace mp4;
+
+// LITERALS
+static const std::unordered_set<std::string> kMp4Extensions  = {".m4b", ".m4a", ".mp4"};
+static const size_t                          kMaxChapters    = 10000;  // anything above is a broken file
+static const uint32_t                        kMaxTitleBytes  = 4096;
+static const int64_t                         kNeroUnitsPerMs = 10000;  // chpl starts are in 100 ns
+
+namespace
+{
+// Nero chapters in moov/udta/chpl: version, flags, a count and (start, title) pairs
+std::vector<Chapter> readNeroChapters(const Box& chpl)
+{
+    std::vector<Chapter> chapters;
+    const uint8_t*       cursor = chpl.data;
+    const uint8_t*       end    = chpl.data + chpl.size;
+    size_t               skip   = chpl.size > 0 && cursor[0] == 1 ? 8 : 4;
+    if (chpl.size < skip + 1)
+    {
+        return chapters;
+    }
+    cursor += skip;
+
+    size_t count = *cursor++;
+    for (size_t i = 0; i < count && end - cursor >= 9; ++i)
+    {
+        Chapter chapter;
+        chapter.start = int64_t(readU64(cursor) / kNeroUnitsPerMs);
+        size_t length = cursor[8];
+        cursor += 9;
+        if (size_t(end - cursor) < length)
+        {
+            break;
+        }
+        chapter.title.assign(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+        chapters.emplace_back(std::move(chapter));
+    }
+    return chapters;
+}
+
+uint32_t trackId(const Box& tkhd)
+{
+    // version 1 has 64 bit creation and modification times
+    size_t offset = tkhd.size > 0 && tkhd.data[0] == 1 ? 20 : 12;
+    return tkhd.size >= offset + 4 ? readU32(tkhd.data + offset) : 0;
+}
+
+uint32_t timescale(const Box& mdhd)
+{
+    size_t offset = mdhd.size > 0 && mdhd.data[0] == 1 ? 20 : 12;
+    return mdhd.size >= offset + 4 ? readU32(mdhd.data + offset) : 0;
+}
+
+// Text samples are UTF-8, or UTF-16 when they start with a byte order mark
+std::string decodeTitle(const uint8_t* data, size_t size)
+{
+    bool hasByteOrderMark = size >= 2 && ((data[0] == 0xfe && data[1] == 0xff) || (data[0] == 0xff && data[1] == 0xfe));
+    if (hasByteOrderMark)
+    {
+        return utf16ToUtf8(data, size, true);
+    }
+    return std::string(reinterpret_cast<const char*>(data), size);
+}
+
+// QuickTime chapters: a text track referenced from another track's tref/chap, one sample per chapter. The sample
+// tables give every sample's time and where it is in the file, each sample is a 16 bit length and the title.
+std::vector<Chapter> readTrackChapters(const Box& movie, std::ifstream& file)
+{
+    std::vector<Chapter> chapters;
+    std::vector<Box>     tracks       = children(movie, fourcc("trak"));
+    uint32_t             chapterTrack = 0;
+    for (const Box& track : tracks)
+    {
+        std::optional<Box> chap = findBox(track, {fourcc("tref"), fourcc("chap")});
+        if (chap && chap->size >= 4)
+        {
+            chapterTrack = readU32(chap->data);
+            break;
+        }
+    }
+    auto trackIt = std::find_if(tracks.begin(), tracks.end(), [chapterTrack](const Box& track) {
+        std::optional<Box> tkhd = findBox(track, {fourcc("tkhd")});
+        return chapterTrack != 0 && tkhd && trackId(*tkhd) == chapterTrack;
+    });
+    if (trackIt == tracks.end())
+    {
+        return chapters;
+    }
+
+    std::optional<Box> mdhd  = findBox(*trackIt, {fourcc("mdia"), fourcc("mdhd")});
+    std::optional<Box> table = findBox(*trackIt, {fourcc("mdia"), fourcc("minf"), fourcc("stbl")});
+    if (!mdhd || !table || timescale(*mdhd) == 0)
+    {
+        return chapters;
+    }
+    std::optional<Box> stts = findBox(*table, {fourcc("stts")});
+    std::optional<Box> stsz = findBox(*table, {fourcc("stsz")});
+    std::optional<Box> stsc = findBox(*table, {fourcc("stsc")});
+    std::optional<Box> stco = findBox(*table, {fourcc("stco")});
+    bool               is64 = !stco;
+    if (is64)
+    {
+        stco = findBox(*table, {fourcc("co64")});
+    }
+    if (!stts || !stsz || !stsc || !stco || stts->size < 8 || stsz->size < 12 || stsc->size < 8 || stco->size < 8)
+    {
+        return chapters;
+    }
+
+    // sample start times
+    std::vector<uint64_t> times;
+    uint64_t              time = 0;
+    size_t                runs = std::min<size_t>(readU32(stts->data + 4), (stts->size - 8) / 8);
+    for (size_t i = 0; i < runs && times.size() < kMaxChapters; ++i)
+    {
+        uint32_t count = readU32(stts->data + 8 + i * 8);
+        uint32_t delta = readU32(stts->data + 12 + i * 8);
+        for (uint32_t j = 0; j < count && times.size() < kMaxChapters; ++j, time += delta)
+        {
+            times.push_back(time);
+        }
+    }
+
+    // sample sizes, all the same or one each
+    uint32_t              commonSize  = readU32(stsz->data + 4);
+    size_t                sampleCount = std::min<size_t>(readU32(stsz->data + 8), times.size());
+    std::vector<uint32_t> sizes(sampleCount, commonSize);
+    if (commonSize == 0)
+    {
+        sampleCount = std::min(sampleCount, (stsz->size - 12) / 4);
+        sizes.resize(sampleCount);
+        for (size_t i = 0; i < sampleCount; ++i)
+        {
+            sizes[i] = readU32(stsz->data + 12 + i * 4);
+        }
+    }
+
+    // chunk offsets, then the samples packed one after the other in each chunk
+    size_t                entrySize  = is64 ? 8 : 4;
+    size_t                chunkCount = std::min<size_t>(readU32(stco->data + 4), (stco->size - 8) / entrySize);
+    size_t                stscCount  = std::min<size_t>(readU32(stsc->data + 4), (stsc->size - 8) / 12);
+    std::vector<uint64_t> offsets;
+    for (size_t i = 0; i < stscCount && offsets.size() < sampleCount; ++i)
+    {
+        const uint8_t* entry           = stsc->data + 8 + i * 12;
+        size_t         firstChunk      = readU32(entry);
+        size_t         samplesPerChunk = readU32(entry + 4);
+        size_t         nextFirstChunk  = i + 1 < stscCount ? readU32(entry + 12) : chunkCount + 1;
+        for (size_t chunk = std::max<size_t>(firstChunk, 1); chunk < nextFirstChunk && chunk <= chunkCount; ++chunk)
+        {
+            const uint8_t* chunkEntry = stco->data + 8 + (chunk - 1) * entrySize;
+            uint64_t       offset     = is64 ? readU64(chunkEntry) : readU32(chunkEntry);
+            for (size_t j = 0; j < samplesPerChunk && offsets.size() < sampleCount; ++j)
+            {
+                offsets.push_back(offset);
+                offset += sizes[offsets.size() - 1];
+            }
+        }
+    }
+
+    uint32_t             scale = timescale(*mdhd);
+    std::vector<uint8_t> sample;
+    for (size_t i = 0; i < offsets.size(); ++i)
+    {
+        sample.resize(std::min(sizes[i], kMaxTitleBytes + 2));
+        file.seekg(std::streamoff(offsets[i]));
+        if (sample.size() < 2 || !file.read(reinterpret_cast<char*>(sample.data()), std::streamsize(sample.size())))
+        {
+            break;
+        }
+        Chapter chapter;
+        chapter.start = int64_t(times[i] * 1000 / scale);
+        chapter.title = decodeTitle(sample.data() + 2, std::min<size_t>(readU16(sample.data()), sample.size() - 2));
+        chapters.emplace_back(std::move(chapter));
+    }
+    return chapters;
+}
+}  // namespace
+
+std::vector<Chapter> readChapters(const std::string& path)
+{
+    std::string extension = fs::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return char(std::tolower(c)); });
+    if (kMp4Extensions.find(extension) == kMp4Extensions.end())
+    {
+        return {};
+    }
+
+    std::ifstream        file(path, std::ios::binary);
+    std::vector<uint8_t> movieData;
+    if (!file || !readMovieBox(file, movieData))
+    {
+        return {};
+    }
+
+    return readChapters(Box {fourcc("moov"), movieData.data(), movieData.size()}, file);
+}
+
+std::vector<Chapter> readChapters(const Box& movie, std::ifstream& file)
+{
+    std::vector<Chapter> chapters = readTrackChapters(movie, file);
+    if (chapters.empty())
+    {
+        if (std::optional<Box> chpl = findBox(movie, {fourcc("udta"), fourcc("chpl")}))
+        {
+            chapters = readNeroChapters(*chpl);
+        }
+    }
+    std::stable_sort(chapters.begin(), chapters.end(),
+                     [](const Chapter& a, const Chapter& b) { return a.start < b.start; });
+    return chapters;
+}
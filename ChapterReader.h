@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Mp4Box.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct Chapter
+{
+    int64_t     start {0};  // ms in the file
+    std::string title;
+};
+
+// Reads the chapter table of an MP4 family file (m4b, m4a, mp4) without decoding it: a QuickTime chapter track as
+// written by iTunes and most audiobook tools, or a Nero chpl list. Only the moov box and the chapter titles are
+// read. Chapters come sorted by start, empty for other formats or files without chapters.
+std::vector<Chapter> readChapters(const std::string& path);
+// Same, from a movie box already read, the file is only read for the chapter titles
+std::vector<Chapter> readChapters(const mp4::Box& movie, std::ifstream& file);
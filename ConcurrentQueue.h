@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Unbounded multi producer / multi consumer queue guarded by a mutex.
+// Used to hand results between worker threads, libVLC event threads and the UI thread.
+template <typename T>
+class ConcurrentQueue
+{
+public:
+    void push(T&& value)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _items.emplace_back(std::move(value));
+        }
+        _condition.notify_one();
+    }
+
+    void push(const T& value)
+    {
+        T copy(value);
+        push(std::move(copy));
+    }
+
+    bool tryPop(T& outValue)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_items.empty())
+        {
+            return false;
+        }
+        outValue = std::move(_items.front());
+        _items.pop_front();
+        return true;
+    }
+
+    void waitPop(T& outValue)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return !_items.empty(); });
+        outValue = std::move(_items.front());
+        _items.pop_front();
+    }
+
+    // returns false if nothing arrived within the timeout
+    template <typename Rep, typename Period>
+    bool waitPop(T& outValue, const std::chrono::duration<Rep, Period>& timeout)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_condition.wait_for(lock, timeout, [this]() { return !_items.empty(); }))
+        {
+            return false;
+        }
+        outValue = std::move(_items.front());
+        _items.pop_front();
+        return true;
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.empty();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.size();
+    }
+
+private:
+    mutable std::mutex      _mutex;
+    std::condition_variable _condition;
+    std::deque<T>           _items;
+};
@@ -0,0 +1,190 @@
+#include "LibraryDatabase.h"
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+// LITERALS
+
+// Schema migrations, migration N brings the database from user_version N to N + 1
+static const std::vector<std::vector<std::string>> kMigrations = {
+    // 1: initial schema
+    {
+        "create table if not exists books (key integer unique primary key, duration integer, author text, name text, series text, description text, path text, thumbnail_path)",
+        "create table if not exists files (key integer unique primary key, book_id integer, last_modified integer, track_number integer, path text)",
+        "create table if not exists bookmarks (key integer unique primary key, book_id integer, name text, file_id, position integer, description text)",
+        "create table if not exists settings (setting text unique primary key, value text)",
+    },
+    // 2: indexes, unique paths and foreign keys. SQLite can't add constraints to existing tables, files and bookmarks
+    // are rebuilt. Duplicated books left behind by repeated discoveries are dropped, keeping the oldest one.
+    {
+        "delete from books where key not in (select min(key) from books group by path)",
+        "create unique index books_path on books (path)",
+        "create table files_new (key integer primary key, book_id integer not null references books (key) on delete cascade, last_modified integer, track_number integer, path text not null unique)",
+        "insert or ignore into files_new (key, book_id, last_modified, track_number, path) select key, book_id, last_modified, track_number, path from files where book_id in (select key from books) and path is not null order by key",
+        "drop table files",
+        "alter table files_new rename to files",
+        "create index files_book_id on files (book_id)",
+        "create table bookmarks_new (key integer primary key, book_id integer not null references books (key) on delete cascade, name text, file_id integer references files (key) on delete set null, position integer, description text)",
+        "insert into bookmarks_new (key, book_id, name, file_id, position, description) select key, book_id, name, (select files.key from files where files.key = bookmarks.file_id), position, description from bookmarks where book_id in (select key from books)",
+        "drop table bookmarks",
+        "alter table bookmarks_new rename to bookmarks",
+        "create index bookmarks_book_id on bookmarks (book_id)",
+    },
+    // 3: library list is paged in name order
+    {
+        "create index books_name on books (name)",
+    },
+    // 4: full text search over the books, an external content table kept in sync with books by triggers. Prefix
+    // indexes make the incremental search box cheap on the first few characters.
+    {
+        "create virtual table books_fts using fts5 (name, author, series, description, content = 'books', content_rowid = 'key', tokenize = 'unicode61 remove_diacritics 2', prefix = '2 3')",
+        "create trigger books_fts_insert after insert on books begin insert into books_fts (rowid, name, author, series, description) values (new.key, new.name, new.author, new.series, new.description); end",
+        "create trigger books_fts_delete after delete on books begin insert into books_fts (books_fts, rowid, name, author, series, description) values ('delete', old.key, old.name, old.author, old.series, old.description); end",
+        "create trigger books_fts_update after update on books begin insert into books_fts (books_fts, rowid, name, author, series, description) values ('delete', old.key, old.name, old.author, old.series, old.description); insert into books_fts (rowid, name, author, series, description) values (new.key, new.name, new.author, new.series, new.description); end",
+        "insert into books_fts (books_fts) values ('rebuild')",
+    },
+    // 5: per file duration for the book timeline. Stored files get their modification time reset so the rescan run
+    // after it parses them again and fills it in.
+    {
+        "alter table files add column duration integer not null default 0",
+        "update files set last_modified = 0",
+    },
+    // 6: one resume point per book, upserted by the checkpoints written while playing
+    {
+        "delete from bookmarks where key not in (select max(key) from bookmarks group by book_id, name)",
+        "create unique index bookmarks_book_name on bookmarks (book_id, name)",
+    },
+    // 7: silences found by the background analysis, one row per analyzed file, null ranges if it has none or failed
+    {
+        "create table silences (file_id integer primary key references files (key) on delete cascade, ranges blob)",
+    },
+    // 8: playback speed per book, null until the book's speed is changed and the playing_speed setting applies
+    {
+        "alter table books add column speed real",
+    },
+    // 9: loudness and true peak per file for volume normalization, null if not analyzed or silent. The stored
+    // analyses are dropped so every file gets measured again.
+    {
+        "alter table files add column loudness real",
+        "alter table files add column true_peak real",
+        "delete from silences",
+    },
+    // 10: waveform overview per file for the scrubber, encoded by Waveform, null if the file couldn't be analyzed.
+    // Stored analyses are dropped again so every file gets one.
+    {
+        "create table waveforms (file_id integer primary key references files (key) on delete cascade, peaks blob)",
+        "delete from silences",
+    },
+    // 11: chapter tables of the files that have one. Stored files of the formats having chapters are marked pending,
+    // the analyzer reads theirs in the background.
+    {
+        "create table chapters (key integer primary key, file_id integer not null references files (key) on delete cascade, start integer, title text)",
+        "create index chapters_file_id on chapters (file_id)",
+        "alter table files add column chapters_pending integer not null default 0",
+        "update files set chapters_pending = 1 where path like '%.m4b' or path like '%.m4a' or path like '%.mp4'",
+    },
+    // 12: analyses that failed are told apart from files without silences, playback measures those live. Failed
+    // files are the ones stored without a waveform.
+    {
+        "alter table silences add column failed integer not null default 0",
+        "update silences set failed = 1 where ranges is null and file_id in (select file_id from waveforms where peaks is null)",
+    },
+    // 13: files of book folders that didn't parse, with their modification time, so rescans only parse them again
+    // once they changed
+    {
+        "create table skipped_files (path text primary key, folder text not null, last_modified integer)",
+        "create index skipped_files_folder on skipped_files (folder)",
+    },
+};
+
+// migrations after which the library is rescanned, by number
+static const std::unordered_set<int> kRescanMigrations = {5};
+
+// Pragmas
+// synchronous = normal keeps a WAL database consistent, only the latest commits can be lost on power loss
+static const int         kBusyTimeoutMs   = 5000;
+static const char* const kWriterPragmas   = "pragma journal_mode = wal; pragma synchronous = normal; "
+                                            "pragma temp_store = memory; pragma cache_size = -16384;";
+static const char* const kReaderPragmas   = "pragma temp_store = memory; pragma cache_size = -32768;";
+static const char* const kMemoryMapPragma = "pragma mmap_size = 268435456;";
+// enabled only once migrations ran, rebuilding a table while they're enforced would cascade deletes
+static const char* const kForeignKeysPragma = "pragma foreign_keys = on;";
+
+bool LibraryDatabase::openWriter(const std::string& path, sqlite3pp::database& db)
+{
+    _path = path;
+    db.disconnect();
+    if (SQLITE_OK != db.connect(_path.c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr))
+    {
+        return false;
+    }
+
+    if (!applyPragmas(db, true))
+    {
+        return false;
+    }
+
+    return migrate(db) && SQLITE_OK == db.execute(kForeignKeysPragma);
+}
+
+bool LibraryDatabase::migrate(sqlite3pp::database& db)
+{
+    int version = 0;
+    {
+        sqlite3pp::query query(db, "pragma user_version");
+        for (auto row : query)
+        {
+            version = row.get<int>(0);
+        }
+    }
+
+    for (; version < int(kMigrations.size()); ++version)
+    {
+        sqlite3pp::transaction tr(db);
+        for (const auto& statement : kMigrations[version])
+        {
+            if (SQLITE_OK != db.execute(statement.c_str()))
+            {
+                std::cout << "Library migration " << version + 1 << " failed: " << db.error_msg() << std::endl;
+                tr.rollback();
+                return false;
+            }
+        }
+
+        std::string setVersion = "pragma user_version = " + std::to_string(version + 1);
+        if (SQLITE_OK != db.execute(setVersion.c_str()) || SQLITE_OK != tr.commit())
+        {
+            return false;
+        }
+        if (kRescanMigrations.count(version + 1))
+        {
+            _needsRescan = true;
+        }
+    }
+    return true;
+}
+
+bool LibraryDatabase::openReader(sqlite3pp::database& db) const
+{
+    db.disconnect();
+    if (_path.empty() || SQLITE_OK != db.connect(_path.c_str(), SQLITE_OPEN_READONLY, nullptr))
+    {
+        return false;
+    }
+
+    return applyPragmas(db, false);
+}
+
+bool LibraryDatabase::applyPragmas(sqlite3pp::database& db, bool writer)
+{
+    db.set_busy_timeout(kBusyTimeoutMs);
+    if (SQLITE_OK != db.execute(writer ? kWriterPragmas : kReaderPragmas))
+    {
+        std::cout << "Failed to configure library database: " << db.error_msg() << std::endl;
+        return false;
+    }
+
+    // not available on every platform, not worth failing for
+    db.execute(kMemoryMapPragma);
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "sqlite3pp/sqlite3pp.h"
+#include <string>
+
+// Opens connections to library.db. The database runs in WAL mode so readers never wait behind the writer:
+// one connection writes (owned by the library writer thread), every other connection is read only.
+class LibraryDatabase
+{
+public:
+    // Opens the read/write connection, switches the file to WAL and brings the schema up to date
+    bool openWriter(const std::string& path, sqlite3pp::database& db);
+    // Read only connection, must be opened after the writer created the file
+    bool openReader(sqlite3pp::database& db) const;
+
+    // A migration reset what scans stored about the files, the library needs an incremental rescan
+    bool needsRescan() const
+    {
+        return _needsRescan;
+    }
+
+private:
+    static bool applyPragmas(sqlite3pp::database& db, bool writer);
+    // Runs the schema migrations newer than the database's user_version, each one in its own transaction
+    bool migrate(sqlite3pp::database& db);
+
+    std::string _path;
+    bool        _needsRescan {false};
+};
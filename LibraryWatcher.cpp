@@ -0,0 +1,294 @@
+#include "LibraryWatcher.h"
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Numeric literals
+static const int kEventWaitMs = 250;
+
+#ifdef __linux__
+static const uint32_t kNotifyMask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ATTRIB;
+#endif
+
+namespace
+{
+// One value per folder, changes whenever a file in it is added, removed, resized or touched
+using FolderSnapshot = std::unordered_map<std::string, size_t>;
+
+void hashCombine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+FolderSnapshot takeSnapshot(const fs::path& rootPath)
+{
+    FolderSnapshot                   snapshot;
+    std::error_code                  errorCode;
+    fs::recursive_directory_iterator rdi(rootPath, fs::directory_options::skip_permission_denied, errorCode);
+    for (; !errorCode && rdi != fs::recursive_directory_iterator(); rdi.increment(errorCode))
+    {
+        const auto& entry = *rdi;
+        if (entry.is_directory(errorCode))
+        {
+            snapshot.emplace(entry.path().string(), 0);
+        }
+        else if (entry.is_regular_file(errorCode))
+        {
+            size_t& signature = snapshot[entry.path().parent_path().string()];
+            hashCombine(signature, std::hash<std::string> {}(entry.path().filename().string()));
+            hashCombine(signature, size_t(entry.file_size(errorCode)));
+            hashCombine(signature, size_t(entry.last_write_time(errorCode).time_since_epoch().count()));
+        }
+    }
+    return snapshot;
+}
+}  // namespace
+
+LibraryWatcher::~LibraryWatcher()
+{
+    stop();
+}
+
+bool LibraryWatcher::start(const std::string& rootPath, FoldersChangedCallback callback, Mode mode)
+{
+    stop();
+
+    std::error_code errorCode;
+    if (!fs::is_directory(rootPath, errorCode))
+    {
+        return false;
+    }
+
+    _rootPath      = rootPath;
+    _callback      = std::move(callback);
+    _stopRequested = false;
+    _dirtyFolders.clear();
+
+#ifdef __linux__
+    if (mode == Mode::Auto && initNotify())
+    {
+        _thread = std::thread([this]() { runNotify(); });
+        return true;
+    }
+#endif
+
+    _thread = std::thread([this]() { runPolling(); });
+    return true;
+}
+
+void LibraryWatcher::stop()
+{
+    _stopRequested = true;
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+#ifdef __linux__
+    closeNotify();
+#endif
+}
+
+void LibraryWatcher::markDirty(const std::string& folder)
+{
+    // the library root itself is not a book
+    if (folder != _rootPath)
+    {
+        _dirtyFolders[folder] = Clock::now();
+    }
+}
+
+void LibraryWatcher::flushQuietFolders()
+{
+    std::vector<std::string> quietFolders;
+    auto                     now = Clock::now();
+    for (auto it = _dirtyFolders.begin(); it != _dirtyFolders.end();)
+    {
+        if (now - it->second >= debounceInterval)
+        {
+            quietFolders.emplace_back(it->first);
+            it = _dirtyFolders.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (!quietFolders.empty() && _callback)
+    {
+        _callback(std::move(quietFolders));
+    }
+}
+
+void LibraryWatcher::runPolling()
+{
+    FolderSnapshot    previous = takeSnapshot(_rootPath);
+    Clock::time_point nextPoll = Clock::now() + pollInterval;
+    while (!_stopRequested)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kEventWaitMs));
+        if (Clock::now() >= nextPoll)
+        {
+            FolderSnapshot current = takeSnapshot(_rootPath);
+            for (const auto& folder : current)
+            {
+                auto previousIt = previous.find(folder.first);
+                if (previousIt == previous.end() || previousIt->second != folder.second)
+                {
+                    markDirty(folder.first);
+                }
+            }
+            for (const auto& folder : previous)
+            {
+                if (current.find(folder.first) == current.end())
+                {
+                    markDirty(folder.first);
+                }
+            }
+            previous = std::move(current);
+            nextPoll = Clock::now() + pollInterval;
+        }
+        flushQuietFolders();
+    }
+}
+
+#ifdef __linux__
+
+bool LibraryWatcher::initNotify()
+{
+    _notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_notifyFd < 0)
+    {
+        std::cout << "inotify unavailable, falling back to polling" << std::endl;
+        return false;
+    }
+
+    watchTree(_rootPath, false);
+    if (_watchedFolders.empty())
+    {
+        closeNotify();
+        return false;
+    }
+    return true;
+}
+
+void LibraryWatcher::closeNotify()
+{
+    if (_notifyFd >= 0)
+    {
+        close(_notifyFd);
+        _notifyFd = -1;
+    }
+    _watchedFolders.clear();
+}
+
+void LibraryWatcher::watchTree(const std::string& folder, bool markNewFolders)
+{
+    int watch = inotify_add_watch(_notifyFd, folder.c_str(), kNotifyMask);
+    if (watch < 0)
+    {
+        // most likely out of watches (fs.inotify.max_user_watches), the rest of the tree stays unwatched
+        std::cout << "Failed to watch " << folder << std::endl;
+        return;
+    }
+    _watchedFolders[watch] = folder;
+    if (markNewFolders)
+    {
+        // files may have landed before the watch was in place
+        markDirty(folder);
+    }
+
+    std::error_code errorCode;
+    for (fs::directory_iterator it(folder, fs::directory_options::skip_permission_denied, errorCode);
+         !errorCode && it != fs::directory_iterator(); it.increment(errorCode))
+    {
+        if (it->is_directory(errorCode) && !it->is_symlink(errorCode))
+        {
+            watchTree(it->path().string(), markNewFolders);
+        }
+    }
+}
+
+void LibraryWatcher::runNotify()
+{
+    alignas(inotify_event) char buffer[16 * 1024];
+    pollfd                      pollFd {_notifyFd, POLLIN, 0};
+    while (!_stopRequested)
+    {
+        int ready = poll(&pollFd, 1, kEventWaitMs);
+        if (ready > 0 && (pollFd.revents & POLLIN))
+        {
+            ssize_t length;
+            while ((length = read(_notifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* ptr = buffer; ptr < buffer + length;)
+                {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW)
+                    {
+                        // events were lost, everything may have changed
+                        for (const auto& watched : _watchedFolders)
+                        {
+                            markDirty(watched.second);
+                        }
+                        continue;
+                    }
+
+                    auto watchedIt = _watchedFolders.find(event->wd);
+                    if (watchedIt == _watchedFolders.end())
+                    {
+                        continue;
+                    }
+
+                    if (event->mask & IN_IGNORED)
+                    {
+                        // watch removed by the kernel, the folder is gone
+                        markDirty(watchedIt->second);
+                        _watchedFolders.erase(watchedIt);
+                        continue;
+                    }
+
+                    const std::string& folder = watchedIt->second;
+                    if (event->len == 0)
+                    {
+                        // event about the watched folder itself
+                        markDirty(folder);
+                        continue;
+                    }
+
+                    std::string childPath = (fs::path(folder) / event->name).string();
+                    if (event->mask & IN_ISDIR)
+                    {
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                        {
+                            watchTree(childPath, true);
+                        }
+                        else
+                        {
+                            markDirty(childPath);
+                        }
+                    }
+                    else
+                    {
+                        markDirty(folder);
+                    }
+                }
+            }
+        }
+        flushQuietFolders();
+    }
+}
+
+#endif
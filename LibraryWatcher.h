@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches the library folder in the background and reports the book folders whose content changed.
+// Uses inotify on Linux and falls back to periodically comparing folder snapshots everywhere else (or when
+// inotify isn't usable, e.g. on network mounts). Events are debounced per folder, a folder is reported only
+// once it has been quiet for the debounce interval, so a book still being copied is picked up in one go.
+class LibraryWatcher
+{
+public:
+    enum class Mode
+    {
+        Auto,     // inotify where available, polling otherwise
+        Polling,  // always poll, needed for shares changed from other machines
+    };
+
+    // Called on the watcher thread with the folders that changed, a folder that was removed is reported too
+    using FoldersChangedCallback = std::function<void(std::vector<std::string>&& folders)>;
+
+    LibraryWatcher() = default;
+    ~LibraryWatcher();
+
+    bool start(const std::string& rootPath, FoldersChangedCallback callback, Mode mode = Mode::Auto);
+    void stop();
+
+    bool isRunning() const
+    {
+        return _thread.joinable();
+    }
+
+    std::chrono::milliseconds debounceInterval {2000};
+    std::chrono::milliseconds pollInterval {5000};
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void runPolling();
+    void markDirty(const std::string& folder);
+    void flushQuietFolders();
+
+#ifdef __linux__
+    bool initNotify();
+    void runNotify();
+    void watchTree(const std::string& folder, bool markNewFolders);
+    void closeNotify();
+
+    int                        _notifyFd {-1};
+    std::map<int, std::string> _watchedFolders;
+#endif
+
+    std::string                              _rootPath;
+    FoldersChangedCallback                   _callback;
+    std::atomic<bool>                        _stopRequested {false};
+    std::thread                              _thread;
+    std::map<std::string, Clock::time_point> _dirtyFolders;
+};
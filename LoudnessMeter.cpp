@@ -0,0 +1,211 @@
+#include "LoudnessMeter.h"
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cmath>
+
+// LITERALS
+static const double kPi                = 3.14159265358979323846;
+static const double kLoudnessOffset    = -0.691;
+static const double kAbsoluteGateLufs  = -70.;
+static const double kRelativeGateLu    = -10.;
+static const int    kStepMs            = 100;
+static const size_t kStepsPerBlock     = 4;
+// K-weighting, BS.1770 gives the coefficients for 48 kHz, these are the analog prototypes they come from so any
+// sample rate works
+static const double kShelfFrequency    = 1681.974450955533;
+static const double kShelfGainDb       = 3.999843853973347;
+static const double kShelfQ            = 0.7071752369554196;
+static const double kHighPassFrequency = 38.13547087602444;
+static const double kHighPassQ         = 0.5003270373238773;
+
+namespace
+{
+double toLoudness(double meanSquare)
+{
+    return kLoudnessOffset + 10. * std::log10(meanSquare);
+}
+
+double fromLoudness(double loudness)
+{
+    return std::pow(10., (loudness - kLoudnessOffset) / 10.);
+}
+}  // namespace
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channels)
+    : _channels(channels)
+    , _states(size_t(channels))
+    , _stepFrames(size_t(std::max(sampleRate * kStepMs / 1000, 1)))
+{
+    double k  = std::tan(kPi * kShelfFrequency / sampleRate);
+    double vh = std::pow(10., kShelfGainDb / 20.);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1. + k / kShelfQ + k * k;
+    _filters[0].b0 = (vh + vb * k / kShelfQ + k * k) / a0;
+    _filters[0].b1 = 2. * (k * k - vh) / a0;
+    _filters[0].b2 = (vh - vb * k / kShelfQ + k * k) / a0;
+    _filters[0].a1 = 2. * (k * k - 1.) / a0;
+    _filters[0].a2 = (1. - k / kShelfQ + k * k) / a0;
+
+    k  = std::tan(kPi * kHighPassFrequency / sampleRate);
+    a0 = 1. + k / kHighPassQ + k * k;
+    _filters[1].b0 = 1.;
+    _filters[1].b1 = -2.;
+    _filters[1].b2 = 1.;
+    _filters[1].a1 = 2. * (k * k - 1.) / a0;
+    _filters[1].a2 = (1. - k / kHighPassQ + k * k) / a0;
+
+    // windowed sinc low pass at the original Nyquist frequency, split into one filter per oversampled phase
+    size_t              taps = kOversampling * kPhaseTaps;
+    std::vector<double> filter(taps);
+    for (size_t n = 0; n < taps; ++n)
+    {
+        double t      = (double(n) - double(taps - 1) / 2.) / double(kOversampling);
+        double sinc   = t == 0. ? 1. : std::sin(kPi * t) / (kPi * t);
+        double window = 0.42 - 0.5 * std::cos(2. * kPi * n / (taps - 1)) + 0.08 * std::cos(4. * kPi * n / (taps - 1));
+        filter[n]     = sinc * window;
+    }
+    _phases.resize(taps);
+    for (size_t phase = 0; phase < kOversampling; ++phase)
+    {
+        double sum = 0.;
+        for (size_t tap = 0; tap < kPhaseTaps; ++tap)
+        {
+            sum += filter[phase + tap * kOversampling];
+        }
+        for (size_t tap = 0; tap < kPhaseTaps; ++tap)
+        {
+            _phases[phase * kPhaseTaps + tap] = float(filter[phase + tap * kOversampling] / sum);
+        }
+    }
+}
+
+void LoudnessMeter::feed(const float* samples, size_t frames)
+{
+    size_t history = kPhaseTaps - 1;
+    _channel.resize(history + frames);
+    _weighted.resize(frames * size_t(_channels));
+    _oversampled.resize(frames);
+
+    for (size_t channel = 0; channel < size_t(_channels); ++channel)
+    {
+        std::copy(_states[channel].history.begin(), _states[channel].history.end(), _channel.begin());
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            _channel[history + frame] = samples[frame * _channels + channel];
+        }
+        measureTruePeak(channel, _channel.data(), frames);
+        kWeight(channel, _channel.data() + history, frames, _weighted.data() + channel * frames);
+    }
+
+    // channel sums of squares, cut where the 100 ms steps end
+    for (size_t offset = 0; offset < frames;)
+    {
+        size_t length = std::min(frames - offset, _stepFrames - _stepFilled);
+        for (size_t channel = 0; channel < size_t(_channels); ++channel)
+        {
+            const float* weighted = _weighted.data() + channel * frames + offset;
+            _stepSum += dotProduct(weighted, weighted, length);
+        }
+        offset += length;
+        _stepFilled += length;
+        if (_stepFilled < _stepFrames)
+        {
+            break;
+        }
+
+        _steps[_stepCount % kStepsPerBlock] = _stepSum;
+        ++_stepCount;
+        _stepFilled = 0;
+        _stepSum    = 0.;
+        if (_stepCount >= kStepsPerBlock)
+        {
+            double blockSum = 0.;
+            for (double step : _steps)
+            {
+                blockSum += step;
+            }
+            _blocks.push_back(blockSum / double(_stepFrames * kStepsPerBlock));
+        }
+    }
+}
+
+std::optional<double> LoudnessMeter::integratedLoudness() const
+{
+    double absoluteGate = fromLoudness(kAbsoluteGateLufs);
+    double sum          = 0.;
+    size_t count        = 0;
+    for (double block : _blocks)
+    {
+        if (block > absoluteGate)
+        {
+            sum += block;
+            ++count;
+        }
+    }
+    if (count == 0)
+    {
+        return std::nullopt;
+    }
+
+    double gate = std::max(absoluteGate, fromLoudness(toLoudness(sum / double(count)) + kRelativeGateLu));
+    sum         = 0.;
+    count       = 0;
+    for (double block : _blocks)
+    {
+        if (block > gate)
+        {
+            sum += block;
+            ++count;
+        }
+    }
+    return toLoudness(sum / double(count));
+}
+
+std::optional<double> LoudnessMeter::truePeak() const
+{
+    if (_peak <= 0.f)
+    {
+        return std::nullopt;
+    }
+    return 20. * std::log10(double(_peak));
+}
+
+// Both biquads, transposed direct form II
+void LoudnessMeter::kWeight(size_t channel, const float* samples, size_t frames, float* outWeighted)
+{
+    ChannelState& state = _states[channel];
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        double value = samples[frame];
+        for (size_t i = 0; i < _filters.size(); ++i)
+        {
+            const Biquad& filter = _filters[i];
+            double        output = filter.b0 * value + state.z1[i];
+            state.z1[i]          = filter.b1 * value - filter.a1 * output + state.z2[i];
+            state.z2[i]          = filter.b2 * value - filter.a2 * output;
+            value                = output;
+        }
+        outWeighted[frame] = float(value);
+    }
+}
+
+// samples starts with the channel's history, frames new samples follow it
+void LoudnessMeter::measureTruePeak(size_t channel, const float* samples, size_t frames)
+{
+    size_t history = kPhaseTaps - 1;
+    for (size_t phase = 0; phase < kOversampling; ++phase)
+    {
+        std::fill(_oversampled.begin(), _oversampled.end(), 0.f);
+        for (size_t tap = 0; tap < kPhaseTaps; ++tap)
+        {
+            multiplyAdd(_oversampled.data(), samples + history - tap, _phases[phase * kPhaseTaps + tap], frames);
+        }
+        _peak = std::max(_peak, peakOf(_oversampled.data(), frames));
+    }
+
+    auto& channelHistory = _states[channel].history;
+    for (size_t i = 0; i < history; ++i)
+    {
+        channelHistory[i] = samples[frames + i];
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Integrated loudness and true peak of a stream as defined by EBU R128 / ITU-R BS.1770, fed block by block.
+// Samples are K-weighted, their mean square is taken over 400 ms blocks overlapping by 75%, and the integrated
+// loudness averages the blocks passing the absolute (-70 LUFS) and relative (-10 LU) gates. The true peak is the
+// largest sample of the stream oversampled 4 times. Mono and stereo, both channels weigh the same.
+class LoudnessMeter
+{
+public:
+    LoudnessMeter(int sampleRate, int channels);
+
+    void feed(const float* samples, size_t frames);
+
+    // LUFS, null if the stream is silent
+    std::optional<double> integratedLoudness() const;
+    // dBTP, null if the stream is silent
+    std::optional<double> truePeak() const;
+
+private:
+    static const size_t kOversampling = 4;
+    static const size_t kPhaseTaps    = 12;
+
+    struct Biquad
+    {
+        double b0 {0.}, b1 {0.}, b2 {0.}, a1 {0.}, a2 {0.};
+    };
+
+    struct ChannelState
+    {
+        double                            z1[2] {0., 0.};  // per biquad
+        double                            z2[2] {0., 0.};
+        std::array<float, kPhaseTaps - 1> history {};  // last input samples, for the oversampling filter
+    };
+
+    void kWeight(size_t channel, const float* samples, size_t frames, float* outWeighted);
+    void measureTruePeak(size_t channel, const float* samples, size_t frames);
+
+    int                       _channels {0};
+    std::array<Biquad, 2>     _filters;
+    std::vector<ChannelState> _states;
+    std::vector<float>        _phases;  // oversampling filter, kPhaseTaps per phase
+    size_t                    _stepFrames {0};  // blocks start every 100 ms
+    size_t                    _stepFilled {0};
+    double                    _stepSum {0.};
+    std::array<double, 4>     _steps {};  // sums of the last four steps make a block
+    size_t                    _stepCount {0};
+    std::vector<double>       _blocks;  // mean square of every block
+    float                     _peak {0.f};
+    std::vector<float>        _channel;  // scratch
+    std::vector<float>        _weighted;
+    std::vector<float>        _oversampled;
+};
@@ -0,0 +1,117 @@
+#include "Mp4Box.h"
+
+// LITERALS
+static const uint64_t kMaxMovieBoxSize = 64 * 1024 * 1024;
+
+namespace mp4
+{
+bool nextBox(const uint8_t*& cursor, const uint8_t* end, Box& outBox)
+{
+    size_t left = size_t(end - cursor);
+    if (left < 8)
+    {
+        return false;
+    }
+    uint64_t size   = readU32(cursor);
+    size_t   header = 8;
+    if (size == 1)
+    {
+        if (left < 16)
+        {
+            return false;
+        }
+        size   = readU64(cursor + 8);
+        header = 16;
+    }
+    else if (size == 0)
+    {
+        // up to the end of the parent
+        size = left;
+    }
+    if (size < header || size > left)
+    {
+        return false;
+    }
+
+    outBox = {readU32(cursor + 4), cursor + header, size_t(size) - header};
+    cursor += size;
+    return true;
+}
+
+std::vector<Box> children(const Box& parent, uint32_t type)
+{
+    std::vector<Box> found;
+    const uint8_t*   cursor = parent.data;
+    Box              box;
+    while (nextBox(cursor, parent.data + parent.size, box))
+    {
+        if (box.type == type)
+        {
+            found.push_back(box);
+        }
+    }
+    return found;
+}
+
+std::optional<Box> findBox(const Box& root, std::initializer_list<uint32_t> path)
+{
+    Box box = root;
+    for (uint32_t type : path)
+    {
+        std::vector<Box> found = children(box, type);
+        if (found.empty())
+        {
+            return std::nullopt;
+        }
+        box = found.front();
+    }
+    return box;
+}
+
+bool readMovieBox(std::ifstream& file, std::vector<uint8_t>& outData)
+{
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = uint64_t(file.tellg());
+    uint64_t offset   = 0;
+    while (offset + 8 <= fileSize)
+    {
+        uint8_t header[16];
+        file.seekg(std::streamoff(offset));
+        if (!file.read(reinterpret_cast<char*>(header), 8))
+        {
+            return false;
+        }
+        uint64_t size       = readU32(header);
+        uint64_t headerSize = 8;
+        if (size == 1)
+        {
+            if (!file.read(reinterpret_cast<char*>(header + 8), 8))
+            {
+                return false;
+            }
+            size       = readU64(header + 8);
+            headerSize = 16;
+        }
+        else if (size == 0)
+        {
+            size = fileSize - offset;
+        }
+        if (size < headerSize || size > fileSize - offset)
+        {
+            return false;
+        }
+
+        if (readU32(header + 4) == fourcc("moov"))
+        {
+            if (size - headerSize > kMaxMovieBoxSize)
+            {
+                return false;
+            }
+            outData.resize(size_t(size - headerSize));
+            return bool(file.read(reinterpret_cast<char*>(outData.data()), std::streamsize(outData.size())));
+        }
+        offset += size;
+    }
+    return false;
+}
+}  // namespace mp4
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <optional>
+#include <vector>
+
+// Walking the box structure of MP4 family files (m4b, m4a, mp4), shared by the readers of their chapters and
+// tags. Boxes are looked up in the movie box read into memory once, numbers are big endian.
+namespace mp4
+{
+constexpr uint32_t fourcc(const char (&name)[5])
+{
+    return uint32_t(uint8_t(name[0])) << 24 | uint32_t(uint8_t(name[1])) << 16 | uint32_t(uint8_t(name[2])) << 8 |
+           uint32_t(uint8_t(name[3]));
+}
+
+inline uint16_t readU16(const uint8_t* data)
+{
+    return uint16_t(data[0] << 8 | data[1]);
+}
+
+inline uint32_t readU32(const uint8_t* data)
+{
+    return uint32_t(data[0]) << 24 | uint32_t(data[1]) << 16 | uint32_t(data[2]) << 8 | uint32_t(data[3]);
+}
+
+inline uint64_t readU64(const uint8_t* data)
+{
+    return uint64_t(readU32(data)) << 32 | readU32(data + 4);
+}
+
+// Payload of a box inside a buffer
+struct Box
+{
+    uint32_t       type {0};
+    const uint8_t* data {nullptr};
+    size_t         size {0};
+};
+
+// Steps over one box, false at the end or on a malformed header
+bool nextBox(const uint8_t*& cursor, const uint8_t* end, Box& outBox);
+// The parent's boxes of that type, in order
+std::vector<Box> children(const Box& parent, uint32_t type);
+// Follows nested boxes, first match at every level
+std::optional<Box> findBox(const Box& root, std::initializer_list<uint32_t> path);
+
+// Walks the top level boxes to the movie box, before or after the media data, and reads its payload
+bool readMovieBox(std::ifstream& file, std::vector<uint8_t>& outData);
+}  // namespace mp4
@@ -0,0 +1,105 @@
+#include "SilenceDetector.h"
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// LITERALS
+static const float   kSilenceRms  = 0.01f;  // -40 dBFS
+static const float   kSilencePeak = 0.04f;  // -28 dBFS, keeps soft consonants out of the pauses
+static const int64_t kChunkMs     = 10;
+
+AudioLevel measureLevel(const float* samples, size_t count)
+{
+    AudioLevel level;
+    level.peak = peakOf(samples, count);
+    level.rms  = count ? std::sqrt(dotProduct(samples, samples, count) / float(count)) : 0.f;
+    return level;
+}
+
+bool isSilent(const AudioLevel& level)
+{
+    return level.rms < kSilenceRms && level.peak < kSilencePeak;
+}
+
+// Pairs of 32 bit milliseconds, enough for files of almost 50 days
+std::string encodeSilenceMap(const SilenceMap& silences)
+{
+    std::vector<uint32_t> values;
+    values.reserve(silences.size() * 2);
+    for (const auto& silence : silences)
+    {
+        values.push_back(uint32_t(silence.start));
+        values.push_back(uint32_t(silence.end));
+    }
+    return std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(uint32_t));
+}
+
+SilenceMap decodeSilenceMap(const void* data, size_t size)
+{
+    SilenceMap            silences;
+    std::vector<uint32_t> values(size / sizeof(uint32_t));
+    if (data && !values.empty())
+    {
+        std::memcpy(values.data(), data, values.size() * sizeof(uint32_t));
+    }
+    silences.reserve(values.size() / 2);
+    for (size_t i = 0; i + 1 < values.size(); i += 2)
+    {
+        silences.push_back({int64_t(values[i]), int64_t(values[i + 1])});
+    }
+    return silences;
+}
+
+bool isInSilence(const SilenceMap& silences, int64_t positionMs, size_t& cursor)
+{
+    while (cursor < silences.size() && silences[cursor].end <= positionMs)
+    {
+        ++cursor;
+    }
+    return cursor < silences.size() && silences[cursor].start <= positionMs;
+}
+
+SilenceDetector::SilenceDetector(int sampleRate, int channels, int64_t minSilenceMs)
+    : _sampleRate(sampleRate)
+    , _channels(channels)
+    , _chunkFrames(size_t(std::max<int64_t>(sampleRate * kChunkMs / 1000, 1)))
+    , _minSilenceFrames(sampleRate * minSilenceMs / 1000)
+{
+}
+
+void SilenceDetector::feed(const float* samples, size_t frames)
+{
+    // chunks don't carry over between blocks, the last one of a block may be shorter
+    for (size_t offset = 0; offset < frames; offset += _chunkFrames)
+    {
+        size_t chunkFrames = std::min(_chunkFrames, frames - offset);
+        bool   silent      = isSilent(measureLevel(samples + offset * _channels, chunkFrames * _channels));
+        if (silent && _silenceStart < 0)
+        {
+            _silenceStart = _frame;
+        }
+        else if (!silent && _silenceStart >= 0)
+        {
+            endSilence();
+        }
+        _frame += int64_t(chunkFrames);
+    }
+}
+
+void SilenceDetector::finish()
+{
+    if (_silenceStart >= 0)
+    {
+        endSilence();
+    }
+}
+
+void SilenceDetector::endSilence()
+{
+    if (_frame - _silenceStart >= _minSilenceFrames)
+    {
+        _silences.push_back({_silenceStart * 1000 / _sampleRate, _frame * 1000 / _sampleRate});
+    }
+    _silenceStart = -1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct AudioLevel
+{
+    float peak {0.f};
+    float rms {0.f};
+};
+
+// Peak and RMS of a block of samples
+AudioLevel measureLevel(const float* samples, size_t count);
+
+// Quiet enough to count as a pause in narration
+bool isSilent(const AudioLevel& level);
+
+struct SilenceRange
+{
+    int64_t start {0};  // ms in the file
+    int64_t end {0};
+};
+
+// The silences of one file in playing order
+using SilenceMap = std::vector<SilenceRange>;
+
+// Compact form stored in the library
+std::string encodeSilenceMap(const SilenceMap& silences);
+SilenceMap  decodeSilenceMap(const void* data, size_t size);
+
+// True if the position is inside one of the silences. The cursor remembers where the previous lookup ended, so
+// following a playing stream is a step or two per call. Reset it to 0 when the position jumps back.
+bool isInSilence(const SilenceMap& silences, int64_t positionMs, size_t& cursor);
+
+// Finds the silences of a stream fed to it block by block, those shorter than the minimum are ignored
+class SilenceDetector
+{
+public:
+    SilenceDetector(int sampleRate, int channels, int64_t minSilenceMs);
+
+    void feed(const float* samples, size_t frames);
+    // Ends a silence still running at the end of the stream
+    void finish();
+
+    const SilenceMap& silences() const
+    {
+        return _silences;
+    }
+
+private:
+    void endSilence();
+
+    int        _sampleRate {0};
+    int        _channels {0};
+    size_t     _chunkFrames {0};  // decisions are made per chunk
+    int64_t    _minSilenceFrames {0};
+    int64_t    _frame {0};
+    int64_t    _silenceStart {-1};  // frame, -1 outside of a silence
+    SilenceMap _silences;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Lock free ring buffer for exactly one producer thread and one consumer thread, e.g. a decoder feeding an audio
+// callback. Neither side ever blocks or allocates. Read and write positions count every item that went through,
+// so the producer can publish a position (the end of a stream, a flush) that the consumer acts on later.
+template <typename T>
+class SpscRing
+{
+    static_assert(std::is_trivially_copyable<T>::value, "items are copied with memcpy");
+
+public:
+    // Rounded up to a power of two
+    explicit SpscRing(size_t capacity = 0)
+    {
+        reset(capacity);
+    }
+
+    // Neither thread may use the ring meanwhile
+    void reset(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        _items.assign(capacity ? size : 0, T {});
+        _mask = _items.empty() ? 0 : _items.size() - 1;
+        _readPosition.store(0, std::memory_order_relaxed);
+        _writePosition.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const
+    {
+        return _items.size();
+    }
+
+    // Producer
+    size_t writeAvailable() const
+    {
+        return _items.size() -
+               (_writePosition.load(std::memory_order_relaxed) - _readPosition.load(std::memory_order_acquire));
+    }
+
+    size_t writePosition() const
+    {
+        return _writePosition.load(std::memory_order_relaxed);
+    }
+
+    // Writes as much as fits, returns the item count written
+    size_t write(const T* items, size_t count)
+    {
+        size_t position = _writePosition.load(std::memory_order_relaxed);
+        count           = std::min(count, writeAvailable());
+        copy(items, count, position, [this](size_t index, const T* source, size_t n)
+             { std::memcpy(&_items[index], source, n * sizeof(T)); });
+        _writePosition.store(position + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer
+    size_t readAvailable() const
+    {
+        return _writePosition.load(std::memory_order_acquire) - _readPosition.load(std::memory_order_relaxed);
+    }
+
+    size_t readPosition() const
+    {
+        return _readPosition.load(std::memory_order_relaxed);
+    }
+
+    size_t read(T* items, size_t count)
+    {
+        size_t position = _readPosition.load(std::memory_order_relaxed);
+        count           = std::min(count, readAvailable());
+        copy(items, count, position, [this](size_t index, T* target, size_t n)
+             { std::memcpy(target, &_items[index], n * sizeof(T)); });
+        _readPosition.store(position + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t discard(size_t count)
+    {
+        count = std::min(count, readAvailable());
+        _readPosition.store(_readPosition.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    // Splits the copy where it wraps around the end of the storage
+    template <typename Pointer, typename Copy>
+    void copy(Pointer items, size_t count, size_t position, Copy&& copyItems)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        size_t index = position & _mask;
+        size_t first = std::min(count, _items.size() - index);
+        copyItems(index, items, first);
+        copyItems(0, items + first, count - first);
+    }
+
+    std::vector<T> _items;
+    size_t         _mask {0};
+    // on separate cache lines, each one is written by one thread only
+    alignas(64) std::atomic<size_t> _readPosition {0};
+    alignas(64) std::atomic<size_t> _writePosition {0};
+};
@@ -0,0 +1,741 @@
+#include "TagReader.h"
+#include "Mp4Box.h"
+#include "TextEncoding.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+using namespace mp4;
+
+// LITERALS
+static const size_t   kHeaderWindow   = 64 * 1024;  // one read covers the headers of most files
+static const size_t   kMaxReadSize    = 16 * 1024 * 1024;
+static const size_t   kMpegSyncWindow = 64 * 1024;  // junk tolerated between an ID3v2 tag and the first frame
+static const size_t   kOggTailWindow  = 64 * 1024;  // holds the last page, at most 65307 bytes
+static const size_t   kId3v1Size      = 128;
+static const uint32_t kOpusSampleRate = 48000;
+static const uint64_t kOggNoGranule   = ~uint64_t(0);
+static const uint32_t kXingFramesFlag = 1;
+static const uint32_t kMp4Utf8Data    = 1;
+static const uint32_t kMp4Utf16Data   = 2;
+
+namespace
+{
+uint32_t readU32LE(const uint8_t* data)
+{
+    return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+}
+
+uint64_t readU64LE(const uint8_t* data)
+{
+    return uint64_t(readU32LE(data)) | uint64_t(readU32LE(data + 4)) << 32;
+}
+
+// 7 bits per byte, so a size never looks like an MPEG frame sync
+uint32_t readSyncSafe(const uint8_t* data)
+{
+    return uint32_t(data[0] & 0x7f) << 21 | uint32_t(data[1] & 0x7f) << 14 | uint32_t(data[2] & 0x7f) << 7 |
+           uint32_t(data[3] & 0x7f);
+}
+
+// The file's bytes, served from a window read once at the start whenever it covers them
+class FileSource
+{
+public:
+    bool open(const std::string& path)
+    {
+        _file.open(path, std::ios::binary);
+        if (!_file || !_file.seekg(0, std::ios::end))
+        {
+            return false;
+        }
+        _size = uint64_t(_file.tellg());
+        _window.resize(size_t(std::min<uint64_t>(_size, kHeaderWindow)));
+        return readFile(0, _window);
+    }
+
+    uint64_t size() const
+    {
+        return _size;
+    }
+
+    std::ifstream& file()
+    {
+        return _file;
+    }
+
+    // Null past the end of the file, valid until the next call
+    const uint8_t* at(uint64_t offset, size_t size)
+    {
+        if (offset > _size || size > _size - offset || size > kMaxReadSize)
+        {
+            return nullptr;
+        }
+        if (offset + size <= _window.size())
+        {
+            return _window.data() + offset;
+        }
+        _scratch.resize(size);
+        return readFile(offset, _scratch) ? _scratch.data() : nullptr;
+    }
+
+private:
+    bool readFile(uint64_t offset, std::vector<uint8_t>& outData)
+    {
+        _file.clear();
+        _file.seekg(std::streamoff(offset));
+        return bool(_file.read(reinterpret_cast<char*>(outData.data()), std::streamsize(outData.size())));
+    }
+
+    std::ifstream        _file;
+    uint64_t             _size {0};
+    std::vector<uint8_t> _window;
+    std::vector<uint8_t> _scratch;
+};
+
+void setIfEmpty(std::string& field, std::string value)
+{
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\0'))
+    {
+        value.pop_back();
+    }
+    if (field.empty())
+    {
+        field = std::move(value);
+    }
+}
+
+// ID3v2 text: an encoding byte, then the text in it
+std::string id3Text(const uint8_t* data, size_t size)
+{
+    if (size < 1)
+    {
+        return {};
+    }
+    switch (data[0])
+    {
+        case 0:
+            return latin1ToUtf8(data + 1, size - 1);
+        case 1:
+            return utf16ToUtf8(data + 1, size - 1, false);
+        case 2:
+            return utf16ToUtf8(data + 1, size - 1, true);
+        default:
+        {
+            const char* text = reinterpret_cast<const char*>(data + 1);
+            return std::string(text, strnlen(text, size - 1));
+        }
+    }
+}
+
+// ID3v2 comment: encoding, language, a short description ending in a null character of the encoding, the text
+std::string id3Comment(const uint8_t* data, size_t size)
+{
+    if (size < 4)
+    {
+        return {};
+    }
+    bool   wide = data[0] == 1 || data[0] == 2;
+    size_t text = 4;
+    if (wide)
+    {
+        while (text + 1 < size && (data[text] != 0 || data[text + 1] != 0))
+        {
+            text += 2;
+        }
+        text += 2;
+    }
+    else
+    {
+        while (text < size && data[text] != 0)
+        {
+            ++text;
+        }
+        text += 1;
+    }
+    if (text >= size)
+    {
+        return {};
+    }
+    // the encoding byte goes with the text
+    std::vector<uint8_t> encoded(data + text - 1, data + size);
+    encoded[0] = data[0];
+    return id3Text(encoded.data(), encoded.size());
+}
+
+// Undoes the unsynchronisation scheme, a zero byte inserted after every 0xff
+std::vector<uint8_t> resynchronize(const uint8_t* data, size_t size)
+{
+    std::vector<uint8_t> result;
+    result.reserve(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        result.push_back(data[i]);
+        if (data[i] == 0xff && i + 1 < size && data[i + 1] == 0)
+        {
+            ++i;
+        }
+    }
+    return result;
+}
+
+void readId3v2Frame(const std::string& id, const uint8_t* data, size_t size, AudioTags& outTags)
+{
+    if (id == "TIT2" || id == "TT2")
+    {
+        setIfEmpty(outTags.title, id3Text(data, size));
+    }
+    else if (id == "TPE1" || id == "TP1")
+    {
+        setIfEmpty(outTags.artist, id3Text(data, size));
+    }
+    else if (id == "TPUB" || id == "TPB")
+    {
+        setIfEmpty(outTags.publisher, id3Text(data, size));
+    }
+    else if (id == "TRCK" || id == "TRK")
+    {
+        setIfEmpty(outTags.trackNumber, id3Text(data, size));
+    }
+    else if (id == "COMM" || id == "COM")
+    {
+        setIfEmpty(outTags.description, id3Comment(data, size));
+    }
+    else if (id == "APIC" || id == "PIC")
+    {
+        outTags.hasPicture = true;
+    }
+}
+
+// The whole tag, header included. Frames of version 2.2 have 3 character ids and 3 byte sizes, 2.4 sizes are sync
+// safe and its frames are unsynchronised one by one rather than as a whole.
+void readId3v2(const uint8_t* tag, size_t tagSize, AudioTags& outTags)
+{
+    int                  version = tag[3];
+    uint8_t              flags   = tag[5];
+    std::vector<uint8_t> body(tag + 10, tag + tagSize);
+    if (version < 4 && (flags & 0x80))
+    {
+        body = resynchronize(body.data(), body.size());
+    }
+
+    size_t cursor = 0;
+    if ((flags & 0x40) && version >= 3 && body.size() >= 4)
+    {
+        // extended header
+        cursor = version == 3 ? readU32(body.data()) + 4 : readSyncSafe(body.data());
+    }
+
+    size_t idSize     = version == 2 ? 3 : 4;
+    size_t headerSize = version == 2 ? 6 : 10;
+    while (cursor + headerSize <= body.size() && body[cursor] != 0)
+    {
+        const uint8_t* header = body.data() + cursor;
+        std::string    id(reinterpret_cast<const char*>(header), idSize);
+        size_t         size       = version == 2 ? size_t(header[3] << 16 | header[4] << 8 | header[5])
+                                  : version == 3 ? readU32(header + 4)
+                                                 : readSyncSafe(header + 4);
+        uint16_t       frameFlags = version == 2 ? 0 : readU16(header + 8);
+        cursor += headerSize;
+        if (size > body.size() - cursor)
+        {
+            break;
+        }
+
+        const uint8_t*       data = body.data() + cursor;
+        std::vector<uint8_t> resynchronized;
+        cursor += size;
+        if (version == 3)
+        {
+            // compressed or encrypted frames are skipped, a group id byte precedes grouped ones
+            if (frameFlags & 0x00c0)
+            {
+                continue;
+            }
+            if ((frameFlags & 0x0020) && size > 0)
+            {
+                ++data;
+                --size;
+            }
+        }
+        else if (version == 4)
+        {
+            if (frameFlags & 0x000c)
+            {
+                continue;
+            }
+            if ((frameFlags & 0x0040) && size > 0)
+            {
+                ++data;
+                --size;
+            }
+            if ((frameFlags & 0x0001) && size >= 4)
+            {
+                // data length indicator
+                data += 4;
+                size -= 4;
+            }
+            if (frameFlags & 0x0002)
+            {
+                resynchronized = resynchronize(data, size);
+                data           = resynchronized.data();
+                size           = resynchronized.size();
+            }
+        }
+        readId3v2Frame(id, data, size, outTags);
+    }
+}
+
+// Fixed size fields of latin-1 text at the end of the file, v1.1 puts the track number at the end of the comment
+void readId3v1(const uint8_t* tag, AudioTags& outTags)
+{
+    setIfEmpty(outTags.title, latin1ToUtf8(tag + 3, 30));
+    setIfEmpty(outTags.artist, latin1ToUtf8(tag + 33, 30));
+    setIfEmpty(outTags.description, latin1ToUtf8(tag + 97, 30));
+    if (tag[125] == 0 && tag[126] != 0)
+    {
+        setIfEmpty(outTags.trackNumber, std::to_string(tag[126]));
+    }
+}
+
+struct MpegFrame
+{
+    uint32_t bitrate {0};  // kbit/s
+    uint32_t sampleRate {0};
+    uint32_t samples {0};  // per frame
+    uint32_t size {0};
+    bool     mpeg1 {false};
+    bool     mono {false};
+};
+
+bool readMpegHeader(const uint8_t* data, MpegFrame& outFrame)
+{
+    static const uint16_t kBitrates[2][3][15] = {
+        {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+         {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+         {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}},
+        {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+         {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+         {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}},
+    };
+    static const uint32_t kSampleRates[3] = {44100, 48000, 32000};
+
+    uint32_t header       = readU32(data);
+    uint32_t version      = header >> 19 & 3;  // 0: 2.5, 2: 2, 3: 1
+    uint32_t layer        = 4 - (header >> 17 & 3);
+    uint32_t bitrateIndex = header >> 12 & 15;
+    uint32_t rateIndex    = header >> 10 & 3;
+    if ((header & 0xffe00000) != 0xffe00000 || version == 1 || layer == 4 || bitrateIndex == 0 ||
+        bitrateIndex == 15 || rateIndex == 3)
+    {
+        return false;
+    }
+
+    bool     mpeg1 = version == 3;
+    uint32_t shift = mpeg1 ? 0 : version == 2 ? 1 : 2;
+    outFrame.mpeg1      = mpeg1;
+    outFrame.mono       = (header >> 6 & 3) == 3;
+    outFrame.bitrate    = kBitrates[mpeg1 ? 0 : 1][layer - 1][bitrateIndex];
+    outFrame.sampleRate = kSampleRates[rateIndex] >> shift;
+    outFrame.samples    = layer == 1 ? 384 : layer == 3 && !mpeg1 ? 576 : 1152;
+
+    uint32_t padding = header >> 9 & 1;
+    outFrame.size    = layer == 1 ? (12 * outFrame.bitrate * 1000 / outFrame.sampleRate + padding) * 4
+                                  : outFrame.samples / 8 * outFrame.bitrate * 1000 / outFrame.sampleRate + padding;
+    return true;
+}
+
+// MPEG audio has no header for the whole stream. A Xing, Info or VBRI header in the first frame counts the frames
+// of variable bitrate files, constant bitrate ones are timed by their size.
+bool readMpegAudio(FileSource& source, uint64_t start, AudioTags& outTags)
+{
+    uint64_t       audioEnd = source.size();
+    const uint8_t* tag = audioEnd >= start + kId3v1Size ? source.at(audioEnd - kId3v1Size, kId3v1Size) : nullptr;
+    if (tag && memcmp(tag, "TAG", 3) == 0)
+    {
+        readId3v1(tag, outTags);
+        audioEnd -= kId3v1Size;
+    }
+
+    size_t         windowSize = size_t(std::min<uint64_t>(kMpegSyncWindow, audioEnd > start ? audioEnd - start : 0));
+    const uint8_t* window     = source.at(start, windowSize);
+    if (!window)
+    {
+        return false;
+    }
+
+    // the first frame header followed by another one, a lone sync pattern can be anything. Without an ID3v2 tag in
+    // front the file has to start with it, anything else isn't MPEG audio.
+    MpegFrame frame;
+    size_t    offset    = 0;
+    size_t    maxOffset = start > 0 ? windowSize : 4;
+    for (;; ++offset)
+    {
+        MpegFrame next;
+        if (offset + 4 > maxOffset)
+        {
+            return false;
+        }
+        if (readMpegHeader(window + offset, frame) &&
+            (offset + frame.size + 4 > windowSize || readMpegHeader(window + offset + frame.size, next)))
+        {
+            break;
+        }
+    }
+
+    const uint8_t* data     = window + offset;
+    size_t         sideInfo = frame.mpeg1 ? (frame.mono ? 17 : 32) : (frame.mono ? 9 : 17);
+    size_t         xing     = 4 + sideInfo;
+    size_t         vbri     = 4 + 32;
+    uint64_t       frames   = 0;
+    if (offset + xing + 12 <= windowSize &&
+        (memcmp(data + xing, "Xing", 4) == 0 || memcmp(data + xing, "Info", 4) == 0) &&
+        (readU32(data + xing + 4) & kXingFramesFlag))
+    {
+        frames = readU32(data + xing + 8);
+    }
+    else if (offset + vbri + 18 <= windowSize && memcmp(data + vbri, "VBRI", 4) == 0)
+    {
+        frames = readU32(data + vbri + 14);
+    }
+
+    if (frames > 0)
+    {
+        outTags.duration = int64_t(frames * frame.samples * 1000 / frame.sampleRate);
+    }
+    else
+    {
+        // bits over kbit/s is ms
+        outTags.duration = int64_t((audioEnd - start - offset) * 8 / frame.bitrate);
+    }
+    return outTags.duration > 0;
+}
+
+// Vorbis comments, used by FLAC, Vorbis and Opus: little endian lengths, a vendor string, then KEY=value pairs
+void readVorbisComments(const uint8_t* data, size_t size, AudioTags& outTags)
+{
+    if (size < 8)
+    {
+        return;
+    }
+    size_t cursor = size_t(readU32LE(data)) + 4;
+    if (cursor > size - 4)
+    {
+        return;
+    }
+    uint32_t count = readU32LE(data + cursor);
+    cursor += 4;
+    for (uint32_t i = 0; i < count && size - cursor >= 4; ++i)
+    {
+        size_t length = readU32LE(data + cursor);
+        cursor += 4;
+        if (length > size - cursor)
+        {
+            break;
+        }
+        std::string comment(reinterpret_cast<const char*>(data + cursor), length);
+        cursor += length;
+
+        size_t equals = comment.find('=');
+        if (equals == std::string::npos)
+        {
+            continue;
+        }
+        std::string key   = comment.substr(0, equals);
+        std::string value = comment.substr(equals + 1);
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return char(std::toupper(c)); });
+        if (key == "TITLE")
+        {
+            setIfEmpty(outTags.title, std::move(value));
+        }
+        else if (key == "ARTIST")
+        {
+            setIfEmpty(outTags.artist, std::move(value));
+        }
+        else if (key == "PUBLISHER" || key == "ORGANIZATION" || key == "LABEL")
+        {
+            setIfEmpty(outTags.publisher, std::move(value));
+        }
+        else if (key == "TRACKNUMBER")
+        {
+            setIfEmpty(outTags.trackNumber, std::move(value));
+        }
+        else if (key == "DESCRIPTION" || key == "COMMENT")
+        {
+            setIfEmpty(outTags.description, std::move(value));
+        }
+        else if (key == "METADATA_BLOCK_PICTURE" || key == "COVERART")
+        {
+            outTags.hasPicture = true;
+        }
+    }
+}
+
+// A chain of metadata blocks after the marker, STREAMINFO first
+bool readFlac(FileSource& source, uint64_t start, AudioTags& outTags)
+{
+    uint64_t cursor = start + 4;
+    uint64_t total  = 0;
+    uint32_t rate   = 0;
+    for (bool last = false; !last;)
+    {
+        const uint8_t* header = source.at(cursor, 4);
+        if (!header)
+        {
+            break;
+        }
+        last            = (header[0] & 0x80) != 0;
+        int      type   = header[0] & 0x7f;
+        uint32_t length = uint32_t(header[1] << 16 | header[2] << 8 | header[3]);
+        cursor += 4;
+
+        const uint8_t* block = nullptr;
+        if (type == 0 && length >= 18 && (block = source.at(cursor, length)))
+        {
+            rate  = uint32_t(block[10] << 12 | block[11] << 4 | block[12] >> 4);
+            total = uint64_t(block[13] & 0x0f) << 32 | readU32(block + 14);
+        }
+        else if (type == 4 && (block = source.at(cursor, length)))
+        {
+            readVorbisComments(block, length, outTags);
+        }
+        else if (type == 6)
+        {
+            outTags.hasPicture = true;
+        }
+        cursor += length;
+    }
+
+    // streams of unknown length have a total of 0
+    if (rate == 0 || total == 0)
+    {
+        return false;
+    }
+    outTags.duration = int64_t(total * 1000 / rate);
+    return true;
+}
+
+// Ogg pages carry the packets of a logical stream. The first two packets are the codec's identification and
+// comment headers, the granule position of the last page is the stream's length in samples.
+bool readOgg(FileSource& source, uint64_t start, AudioTags& outTags)
+{
+    std::vector<std::vector<uint8_t>> packets;
+    std::vector<uint8_t>              packet;
+    std::vector<uint8_t>              lacing;
+    std::optional<uint32_t>           serial;
+    uint64_t                          cursor = start;
+    while (packets.size() < 2)
+    {
+        const uint8_t* header = source.at(cursor, 27);
+        if (!header || memcmp(header, "OggS", 4) != 0)
+        {
+            return false;
+        }
+        uint32_t pageSerial = readU32LE(header + 14);
+        size_t   segments   = header[26];
+        serial              = serial.value_or(pageSerial);
+
+        const uint8_t* table = source.at(cursor + 27, segments);
+        if (!table)
+        {
+            return false;
+        }
+        lacing.assign(table, table + segments);
+        size_t dataSize = 0;
+        for (uint8_t lace : lacing)
+        {
+            dataSize += lace;
+        }
+        const uint8_t* data = source.at(cursor + 27 + segments, dataSize);
+        if (!data)
+        {
+            return false;
+        }
+        cursor += 27 + segments + dataSize;
+        if (pageSerial != *serial)
+        {
+            continue;
+        }
+
+        // a packet ends on the first segment shorter than 255 bytes
+        for (uint8_t lace : lacing)
+        {
+            packet.insert(packet.end(), data, data + lace);
+            data += lace;
+            if (lace < 255)
+            {
+                packets.emplace_back(std::move(packet));
+                packet.clear();
+            }
+        }
+        if (packet.size() > kMaxReadSize)
+        {
+            return false;
+        }
+    }
+
+    const std::vector<uint8_t>& identification = packets[0];
+    const std::vector<uint8_t>& comments       = packets[1];
+    uint32_t                    rate           = 0;
+    uint64_t                    preSkip        = 0;
+    if (identification.size() >= 16 && memcmp(identification.data(), "\x01vorbis", 7) == 0 &&
+        comments.size() >= 7 && memcmp(comments.data(), "\x03vorbis", 7) == 0)
+    {
+        rate = readU32LE(identification.data() + 12);
+        readVorbisComments(comments.data() + 7, comments.size() - 7, outTags);
+    }
+    else if (identification.size() >= 19 && memcmp(identification.data(), "OpusHead", 8) == 0 &&
+             comments.size() >= 8 && memcmp(comments.data(), "OpusTags", 8) == 0)
+    {
+        // Opus granules always count 48 kHz samples, from before the encoder's padding
+        rate    = kOpusSampleRate;
+        preSkip = uint64_t(identification[10] | identification[11] << 8);
+        readVorbisComments(comments.data() + 8, comments.size() - 8, outTags);
+    }
+    if (rate == 0)
+    {
+        return false;
+    }
+
+    // the last page of the stream with a granule position, searched backwards from the end
+    size_t         tailSize = size_t(std::min<uint64_t>(kOggTailWindow, source.size() - start));
+    const uint8_t* tail     = source.at(source.size() - tailSize, tailSize);
+    if (!tail || tailSize < 27)
+    {
+        return false;
+    }
+    for (size_t offset = tailSize - 27 + 1; offset-- > 0;)
+    {
+        const uint8_t* page = tail + offset;
+        if (memcmp(page, "OggS", 4) != 0 || readU32LE(page + 14) != *serial)
+        {
+            continue;
+        }
+        uint64_t granule = readU64LE(page + 6);
+        if (granule != kOggNoGranule && granule > preSkip)
+        {
+            outTags.duration = int64_t((granule - preSkip) * 1000 / rate);
+            return outTags.duration > 0;
+        }
+    }
+    return false;
+}
+
+// iTunes style items in moov/udta/meta/ilst, every item holds a data box: a type, a locale and the value
+std::optional<Box> itemData(const Box& items, uint32_t type)
+{
+    std::optional<Box> data = findBox(items, {type, fourcc("data")});
+    if (!data || data->size < 8)
+    {
+        return std::nullopt;
+    }
+    return Box {data->type, data->data + 8, data->size - 8};
+}
+
+std::string itemText(const Box& items, uint32_t type)
+{
+    std::optional<Box> data = findBox(items, {type, fourcc("data")});
+    if (!data || data->size < 8)
+    {
+        return {};
+    }
+    uint32_t       dataType = readU32(data->data) & 0xffffff;
+    const uint8_t* value    = data->data + 8;
+    size_t         size     = data->size - 8;
+    if (dataType == kMp4Utf16Data)
+    {
+        return utf16ToUtf8(value, size, true);
+    }
+    return dataType == kMp4Utf8Data ? std::string(reinterpret_cast<const char*>(value), size) : std::string();
+}
+
+bool readMp4(FileSource& source, AudioTags& outTags)
+{
+    std::vector<uint8_t> movieData;
+    if (!readMovieBox(source.file(), movieData))
+    {
+        return false;
+    }
+    Box movie {fourcc("moov"), movieData.data(), movieData.size()};
+
+    // version 1 has 64 bit times and duration
+    std::optional<Box> mvhd = findBox(movie, {fourcc("mvhd")});
+    if (mvhd && mvhd->size >= 20)
+    {
+        bool     is64     = mvhd->data[0] == 1;
+        size_t   offset   = is64 ? 20 : 12;
+        uint32_t scale    = mvhd->size >= offset + 12 ? readU32(mvhd->data + offset) : 0;
+        uint64_t duration = is64 && scale ? readU64(mvhd->data + offset + 4)
+                            : scale       ? readU32(mvhd->data + offset + 4)
+                                          : 0;
+        if (scale != 0)
+        {
+            outTags.duration = int64_t(duration * 1000 / scale);
+        }
+    }
+
+    // meta is a full box, its children come after the version and flags
+    std::optional<Box> meta = findBox(movie, {fourcc("udta"), fourcc("meta")});
+    if (meta && meta->size >= 4)
+    {
+        Box                metaChildren {meta->type, meta->data + 4, meta->size - 4};
+        std::optional<Box> items = findBox(metaChildren, {fourcc("ilst")});
+        if (items)
+        {
+            setIfEmpty(outTags.title, itemText(*items, fourcc("\xa9nam")));
+            setIfEmpty(outTags.artist, itemText(*items, fourcc("\xa9" "ART")));
+            setIfEmpty(outTags.publisher, itemText(*items, fourcc("\xa9pub")));
+            setIfEmpty(outTags.description, itemText(*items, fourcc("desc")));
+            setIfEmpty(outTags.description, itemText(*items, fourcc("\xa9" "cmt")));
+            std::optional<Box> track = itemData(*items, fourcc("trkn"));
+            if (track && track->size >= 4 && readU16(track->data + 2) != 0)
+            {
+                setIfEmpty(outTags.trackNumber, std::to_string(readU16(track->data + 2)));
+            }
+            outTags.hasPicture = bool(itemData(*items, fourcc("covr")));
+        }
+    }
+    outTags.chapters = readChapters(movie, source.file());
+    return outTags.duration > 0;
+}
+}  // namespace
+
+bool readAudioTags(const std::string& path, AudioTags& outTags)
+{
+    FileSource source;
+    if (!source.open(path))
+    {
+        return false;
+    }
+
+    // an ID3v2 tag can lead any of them, usually MP3
+    uint64_t       start  = 0;
+    const uint8_t* header = source.at(0, 10);
+    if (header && memcmp(header, "ID3", 3) == 0 && header[3] >= 2 && header[3] <= 4)
+    {
+        size_t tagSize = 10 + readSyncSafe(header + 6) + (header[5] & 0x10 ? 10 : 0);
+        if (const uint8_t* tag = source.at(0, tagSize))
+        {
+            readId3v2(tag, tagSize, outTags);
+        }
+        start = tagSize;
+    }
+
+    const uint8_t* magic = source.at(start, 12);
+    if (magic && memcmp(magic, "fLaC", 4) == 0)
+    {
+        return readFlac(source, start, outTags);
+    }
+    if (magic && memcmp(magic, "OggS", 4) == 0)
+    {
+        return readOgg(source, start, outTags);
+    }
+    if (magic && start == 0 && memcmp(magic + 4, "ftyp", 4) == 0)
+    {
+        return readMp4(source, outTags);
+    }
+    return readMpegAudio(source, start, outTags);
+}
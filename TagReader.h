@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ChapterReader.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a file's tags and headers say about it, the part of a libVLC parse the library needs
+struct AudioTags
+{
+    std::string          title;
+    std::string          artist;
+    std::string          publisher;
+    std::string          trackNumber;
+    std::string          description;
+    int64_t              duration {0};        // ms
+    bool                 hasPicture {false};  // an embedded cover, only libVLC extracts those
+    std::vector<Chapter> chapters;            // MP4 family only, read from the same movie box
+};
+
+// Reads the tags and duration of MP3 (ID3v2, ID3v1), MP4 family (iTunes items), FLAC and Ogg Vorbis or Opus files
+// without decoding them. Only the headers are read: a window at the start of the file, plus the movie box of MP4
+// files, the last pages of Ogg ones and the rest of a tag larger than the window. False for other formats, or when
+// the duration can't be found this way; libVLC parses those.
+bool readAudioTags(const std::string& path, AudioTags& outTags);
@@ -0,0 +1,81 @@
+#include "TextEncoding.h"
+
+namespace
+{
+void appendUtf8(std::string& text, uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        text += char(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        text += char(0xc0 | codePoint >> 6);
+        text += char(0x80 | (codePoint & 0x3f));
+    }
+    else if (codePoint < 0x10000)
+    {
+        text += char(0xe0 | codePoint >> 12);
+        text += char(0x80 | (codePoint >> 6 & 0x3f));
+        text += char(0x80 | (codePoint & 0x3f));
+    }
+    else
+    {
+        text += char(0xf0 | codePoint >> 18);
+        text += char(0x80 | (codePoint >> 12 & 0x3f));
+        text += char(0x80 | (codePoint >> 6 & 0x3f));
+        text += char(0x80 | (codePoint & 0x3f));
+    }
+}
+}  // namespace
+
+std::string latin1ToUtf8(const uint8_t* data, size_t size)
+{
+    std::string text;
+    text.reserve(size);
+    for (size_t i = 0; i < size && data[i] != 0; ++i)
+    {
+        appendUtf8(text, data[i]);
+    }
+    return text;
+}
+
+std::string utf16ToUtf8(const uint8_t* data, size_t size, bool bigEndian)
+{
+    size_t start = 0;
+    if (size >= 2 && ((data[0] == 0xfe && data[1] == 0xff) || (data[0] == 0xff && data[1] == 0xfe)))
+    {
+        bigEndian = data[0] == 0xfe;
+        start     = 2;
+    }
+
+    auto unitAt = [&](size_t i) -> uint32_t {
+        return bigEndian ? uint32_t(data[i] << 8 | data[i + 1]) : uint32_t(data[i + 1] << 8 | data[i]);
+    };
+    std::string text;
+    for (size_t i = start; i + 1 < size; i += 2)
+    {
+        uint32_t unit = unitAt(i);
+        if (unit == 0)
+        {
+            break;
+        }
+        if (unit >= 0xd800 && unit < 0xe000)
+        {
+            uint32_t next = i + 3 < size ? unitAt(i + 2) : 0;
+            if (unit < 0xdc00 && next >= 0xdc00 && next < 0xe000)
+            {
+                // surrogate pair
+                unit = 0x10000 + ((unit - 0xd800) << 10) + (next - 0xdc00);
+                i += 2;
+            }
+            else
+            {
+                // unpaired surrogate, the next unit is decoded on its own
+                unit = 0xfffd;
+            }
+        }
+        appendUtf8(text, unit);
+    }
+    return text;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Tags and chapter titles come in several encodings, the library stores UTF-8
+
+std::string latin1ToUtf8(const uint8_t* data, size_t size);
+
+// A byte order mark at the start wins over bigEndian, stops at a null character
+std::string utf16ToUtf8(const uint8_t* data, size_t size, bool bigEndian);
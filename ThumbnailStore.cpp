@@ -0,0 +1,226 @@
+#include "ThumbnailStore.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+// LITERALS
+static const uint32_t    kThumbnailMagic   = 0x4e544241;  // "ABTN"
+static const uint32_t    kThumbnailVersion = 1;
+static const std::string kThumbnailExt     = ".thumb";
+
+namespace
+{
+#pragma pack(push, 1)
+struct ThumbnailHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t  sourceLastModified;
+    uint32_t width;
+    uint32_t height;
+};
+#pragma pack(pop)
+
+// FNV-1a, file names have to stay the same across runs and builds
+uint64_t hashPath(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : path)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Box filter, every destination pixel averages the source pixels it covers
+RgbaImage scaleDown(const uint8_t* pixels, int width, int height, int maxSize)
+{
+    RgbaImage image;
+    float     scale = std::min(1.f, float(maxSize) / std::max(width, height));
+    image.width     = std::max(1, int(width * scale + 0.5f));
+    image.height    = std::max(1, int(height * scale + 0.5f));
+    image.pixels.resize(size_t(image.width) * image.height * 4);
+
+    uint8_t* dst = image.pixels.data();
+    for (int y = 0; y < image.height; ++y)
+    {
+        int y0 = int(int64_t(y) * height / image.height);
+        int y1 = std::max(y0 + 1, int(int64_t(y + 1) * height / image.height));
+        for (int x = 0; x < image.width; ++x)
+        {
+            int      x0     = int(int64_t(x) * width / image.width);
+            int      x1     = std::max(x0 + 1, int(int64_t(x + 1) * width / image.width));
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int sy = y0; sy < y1; ++sy)
+            {
+                const uint8_t* src = pixels + (size_t(sy) * width + x0) * 4;
+                for (int sx = x0; sx < x1; ++sx, src += 4)
+                {
+                    sum[0] += src[0];
+                    sum[1] += src[1];
+                    sum[2] += src[2];
+                    sum[3] += src[3];
+                }
+            }
+            uint32_t count = uint32_t((y1 - y0) * (x1 - x0));
+            for (int c = 0; c < 4; ++c)
+            {
+                *dst++ = uint8_t((sum[c] + count / 2) / count);
+            }
+        }
+    }
+    return image;
+}
+}  // namespace
+
+bool ThumbnailStore::open(const std::string& directory, int maxSize)
+{
+    std::error_code errorCode;
+    fs::create_directories(directory, errorCode);
+    if (errorCode)
+    {
+        std::cout << "Failed to create thumbnail cache " << directory << ": " << errorCode.message() << std::endl;
+        return false;
+    }
+
+    _directory = directory;
+    _maxSize   = maxSize;
+    return true;
+}
+
+bool ThumbnailStore::update(const std::string& imagePath) const
+{
+    Source source;
+    if (!readSource(imagePath, source))
+    {
+        return false;
+    }
+
+    std::string path = thumbnailPath(imagePath);
+    if (readThumbnail(path, source, nullptr))
+    {
+        return true;
+    }
+
+    RgbaImage image;
+    return createThumbnail(imagePath, source, image);
+}
+
+bool ThumbnailStore::load(const std::string& imagePath, RgbaImage& outImage) const
+{
+    Source source;
+    if (!readSource(imagePath, source))
+    {
+        return false;
+    }
+
+    return readThumbnail(thumbnailPath(imagePath), source, &outImage) ||
+           createThumbnail(imagePath, source, outImage);
+}
+
+bool ThumbnailStore::readSource(const std::string& imagePath, Source& outSource)
+{
+    std::error_code errorCode;
+    outSource.size         = fs::file_size(imagePath, errorCode);
+    outSource.lastModified = fs::last_write_time(imagePath, errorCode).time_since_epoch().count();
+    return !errorCode;
+}
+
+std::string ThumbnailStore::thumbnailPath(const std::string& imagePath) const
+{
+    std::ostringstream name;
+    name << std::hex << hashPath(fs::path(imagePath).lexically_normal().string()) << kThumbnailExt;
+    return (fs::path(_directory) / name.str()).string();
+}
+
+bool ThumbnailStore::readThumbnail(const std::string& path, const Source& source, RgbaImage* outImage) const
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    ThumbnailHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kThumbnailMagic ||
+        header.version != kThumbnailVersion || header.sourceSize != source.size ||
+        header.sourceLastModified != source.lastModified || header.width == 0 || header.height == 0 ||
+        header.width > uint32_t(_maxSize) || header.height > uint32_t(_maxSize))
+    {
+        return false;
+    }
+
+    if (outImage)
+    {
+        outImage->width  = int(header.width);
+        outImage->height = int(header.height);
+        outImage->pixels.resize(size_t(header.width) * header.height * 4);
+        if (!file.read(reinterpret_cast<char*>(outImage->pixels.data()), outImage->pixels.size()))
+        {
+            // truncated, rewritten by the caller
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ThumbnailStore::writeThumbnail(const std::string& path, const Source& source, const RgbaImage& image) const
+{
+    // written next to the final file and renamed over it, readers never see a partial thumbnail
+    std::ostringstream tempPath;
+    tempPath << path << "." << std::hash<std::thread::id> {}(std::this_thread::get_id()) << ".tmp";
+    {
+        std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+
+        ThumbnailHeader header {kThumbnailMagic,    kThumbnailVersion,     source.size,
+                                source.lastModified, uint32_t(image.width), uint32_t(image.height)};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    std::error_code errorCode;
+    fs::rename(tempPath.str(), path, errorCode);
+    if (errorCode)
+    {
+        fs::remove(tempPath.str(), errorCode);
+        return false;
+    }
+    return true;
+}
+
+bool ThumbnailStore::createThumbnail(const std::string& imagePath, const Source& source, RgbaImage& outImage) const
+{
+    int                                                  width, height, channels;
+    std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(
+        stbi_load(imagePath.c_str(), &width, &height, &channels, 4), &stbi_image_free);
+    if (!pixels)
+    {
+        return false;
+    }
+
+    outImage = scaleDown(pixels.get(), width, height, _maxSize);
+    if (!writeThumbnail(thumbnailPath(imagePath), source, outImage))
+    {
+        // still usable for this run
+        std::cout << "Failed to write thumbnail of " << imagePath << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tightly packed 8 bit RGBA pixels
+struct RgbaImage
+{
+    int                  width {0};
+    int                  height {0};
+    std::vector<uint8_t> pixels;
+};
+
+// On disk cache of cover thumbnails. Every source image gets one file in the cache directory holding its pixels
+// scaled down to at most maxSize on the longest edge, already decoded, so loading a cover is one small read.
+// The file name is derived from the source path and the header records the source's size and modification
+// time, a thumbnail is valid as long as they still match. All methods are thread safe once open() returned.
+class ThumbnailStore
+{
+public:
+    bool open(const std::string& directory, int maxSize);
+
+    // Creates or refreshes the thumbnail of the image, does nothing if it is up to date
+    bool update(const std::string& imagePath) const;
+    // Loads the thumbnail, creating it first if it's missing or stale
+    bool load(const std::string& imagePath, RgbaImage& outImage) const;
+
+private:
+    struct Source
+    {
+        uint64_t size {0};
+        int64_t  lastModified {0};
+    };
+
+    static bool readSource(const std::string& imagePath, Source& outSource);
+
+    std::string thumbnailPath(const std::string& imagePath) const;
+    bool        readThumbnail(const std::string& path, const Source& source, RgbaImage* outImage) const;
+    bool        writeThumbnail(const std::string& path, const Source& source, const RgbaImage& image) const;
+    bool        createThumbnail(const std::string& imagePath, const Source& source, RgbaImage& outImage) const;
+
+    std::string _directory;
+    int         _maxSize {0};
+};
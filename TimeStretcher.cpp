@@ -0,0 +1,196 @@
+#include "TimeStretcher.h"
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// LITERALS
+static const int    kFrameMs    = 20;   // a couple of pitch periods of a low voice
+static const int    kSearchMs   = 8;
+static const int    kInputMs    = 200;  // buffered input, far more than a frame and its search range
+static const size_t kCoarseStep = 4;    // search step, refined around the best candidate
+static const float  kMinEnergy  = 1e-9f;
+static const double kPi         = 3.14159265358979323846;
+
+void TimeStretcher::prepare(int sampleRate, int channels)
+{
+    _channels     = size_t(channels);
+    _frameFrames  = size_t(sampleRate * kFrameMs / 1000) & ~size_t(1);
+    _hopFrames    = _frameFrames / 2;
+    _searchFrames = size_t(sampleRate * kSearchMs / 1000);
+    _capacity     = size_t(sampleRate * kInputMs / 1000);
+
+    // periodic Hann, the falling half of one frame and the rising half of the next sum to 1
+    _window.resize(_frameFrames);
+    for (size_t i = 0; i < _frameFrames; ++i)
+    {
+        _window[i] = float(0.5 - 0.5 * std::cos(2. * kPi * double(i) / double(_frameFrames)));
+    }
+
+    _input.assign(_capacity * _channels, 0.f);
+    _mono.assign(_capacity, 0.f);
+    _overlap.assign(_hopFrames * _channels, 0.f);
+    // finish() plays out a hop and the whole input through it
+    _output.assign((_hopFrames + _capacity) * _channels, 0.f);
+    reset();
+}
+
+void TimeStretcher::reset()
+{
+    _inputFrames      = 0;
+    _analysisPosition = 0.;
+    _naturalPosition  = 0;
+    _hasPrevious      = false;
+    std::fill(_overlap.begin(), _overlap.end(), 0.f);
+}
+
+size_t TimeStretcher::write(const float* samples, size_t frames)
+{
+    if (_inputFrames + frames > _capacity)
+    {
+        compact();
+    }
+
+    frames = std::min(frames, _capacity - _inputFrames);
+    std::memcpy(&_input[_inputFrames * _channels], samples, frames * _channels * sizeof(float));
+    float scale = 1.f / float(_channels);
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        float sum = 0.f;
+        for (size_t channel = 0; channel < _channels; ++channel)
+        {
+            sum += samples[frame * _channels + channel];
+        }
+        _mono[_inputFrames + frame] = sum * scale;
+    }
+    _inputFrames += frames;
+    return frames;
+}
+
+const float* TimeStretcher::next(float speed)
+{
+    size_t nominal = size_t(_analysisPosition + 0.5);
+    size_t needed  = nominal + _searchFrames + _frameFrames;
+    if (_hasPrevious)
+    {
+        needed = std::max(needed, _naturalPosition + _hopFrames);
+    }
+    if (needed > _inputFrames)
+    {
+        return nullptr;
+    }
+
+    size_t       position = _hasPrevious ? search(nominal, _naturalPosition) : nominal;
+    const float* frame    = &_input[position * _channels];
+    for (size_t i = 0; i < _hopFrames; ++i)
+    {
+        float rising  = _window[i];
+        float falling = _window[i + _hopFrames];
+        for (size_t channel = 0; channel < _channels; ++channel)
+        {
+            size_t sample    = i * _channels + channel;
+            _output[sample]  = _overlap[sample] + frame[sample] * rising;
+            _overlap[sample] = frame[_hopFrames * _channels + sample] * falling;
+        }
+    }
+
+    _naturalPosition = position + _hopFrames;
+    _hasPrevious     = true;
+    _analysisPosition += double(_hopFrames) * double(speed);
+    return _output.data();
+}
+
+size_t TimeStretcher::finish(const float*& outSamples)
+{
+    size_t frames = 0;
+    size_t start  = 0;
+    if (_hasPrevious)
+    {
+        // the previous frame fades out against its natural continuation, the rest follows unchanged
+        for (size_t i = 0; i < _hopFrames; ++i)
+        {
+            size_t inputFrame = _naturalPosition + i;
+            for (size_t channel = 0; channel < _channels; ++channel)
+            {
+                size_t sample   = i * _channels + channel;
+                float  value    = inputFrame < _inputFrames ? _input[inputFrame * _channels + channel] : 0.f;
+                _output[sample] = _overlap[sample] + value * _window[i];
+            }
+        }
+        frames = _hopFrames;
+        start  = _naturalPosition + _hopFrames;
+    }
+    if (start < _inputFrames)
+    {
+        std::memcpy(&_output[frames * _channels], &_input[start * _channels],
+                    (_inputFrames - start) * _channels * sizeof(float));
+        frames += _inputFrames - start;
+    }
+
+    reset();
+    outSamples = _output.data();
+    return frames;
+}
+
+// Normalized cross correlation of the candidates' start with the natural continuation, coarse then fine
+size_t TimeStretcher::search(size_t nominal, size_t natural) const
+{
+    const float* reference = &_mono[natural];
+    size_t       first     = nominal > _searchFrames ? nominal - _searchFrames : 0;
+    size_t       last      = nominal + _searchFrames;
+
+    auto score = [&](size_t candidate) {
+        const float* samples = &_mono[candidate];
+        float        energy  = dotProduct(samples, samples, _hopFrames);
+        return dotProduct(samples, reference, _hopFrames) / std::sqrt(std::max(energy, kMinEnergy));
+    };
+
+    size_t best      = nominal;
+    float  bestScore = score(nominal);
+    for (size_t candidate = first; candidate <= last; candidate += kCoarseStep)
+    {
+        float candidateScore = score(candidate);
+        if (candidateScore > bestScore)
+        {
+            best      = candidate;
+            bestScore = candidateScore;
+        }
+    }
+
+    size_t coarseBest = best;
+    size_t fineFirst  = std::max(coarseBest, first + kCoarseStep - 1) - (kCoarseStep - 1);
+    size_t fineLast   = std::min(coarseBest + kCoarseStep - 1, last);
+    for (size_t candidate = fineFirst; candidate <= fineLast; ++candidate)
+    {
+        float candidateScore = score(candidate);
+        if (candidateScore > bestScore)
+        {
+            best      = candidate;
+            bestScore = candidateScore;
+        }
+    }
+    return best;
+}
+
+// Drops input no future frame can start in
+void TimeStretcher::compact()
+{
+    size_t nominal = size_t(_analysisPosition + 0.5);
+    size_t keep    = nominal > _searchFrames ? nominal - _searchFrames : 0;
+    if (_hasPrevious)
+    {
+        keep = std::min(keep, _naturalPosition);
+    }
+    keep = std::min(keep, _inputFrames);
+    if (keep == 0)
+    {
+        return;
+    }
+
+    size_t remaining = _inputFrames - keep;
+    std::memmove(_input.data(), &_input[keep * _channels], remaining * _channels * sizeof(float));
+    std::memmove(_mono.data(), &_mono[keep], remaining * sizeof(float));
+    _inputFrames = remaining;
+    _analysisPosition -= double(keep);
+    _naturalPosition -= std::min(keep, _naturalPosition);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Changes the speed of speech without changing its pitch, by WSOLA (waveform similarity overlap-add). Output is
+// built from Hann windowed frames overlapping by half. Each next frame is taken from the input around where the
+// speed puts it, shifted within a small search range to the offset that best continues the previous frame's
+// waveform, so no pitch periods are cut in half. The search compares a fixed number of candidates over a fixed
+// length, every output hop costs the same whatever the speed.
+// All buffers are allocated by prepare(), write(), next() and finish() only copy and compute.
+class TimeStretcher
+{
+public:
+    void prepare(int sampleRate, int channels);
+    // Forgets the buffered input, the next output fades in
+    void reset();
+
+    bool hasInput() const
+    {
+        return _inputFrames > 0;
+    }
+    size_t hopFrames() const
+    {
+        return _hopFrames;
+    }
+    // The most finish() can return
+    size_t maxTailFrames() const
+    {
+        return _hopFrames + _capacity;
+    }
+
+    // Buffers as much of the input as fits, returns the frames taken
+    size_t write(const float* samples, size_t frames);
+    // The next hopFrames() of output, or null if more input is needed first
+    const float* next(float speed);
+    // Everything still buffered, played out at the original speed, then reset(). Returns the frame count.
+    size_t finish(const float*& outSamples);
+
+private:
+    size_t search(size_t nominal, size_t natural) const;
+    void   compact();
+
+    size_t             _channels {0};
+    size_t             _frameFrames {0};   // window length
+    size_t             _hopFrames {0};     // output hop, half the window
+    size_t             _searchFrames {0};  // candidates are the nominal position +- this
+    size_t             _capacity {0};      // input frames
+    std::vector<float> _window;
+    std::vector<float> _input;  // interleaved
+    std::vector<float> _mono;   // the input downmixed, what the search compares
+    std::vector<float> _overlap;
+    std::vector<float> _output;
+    size_t             _inputFrames {0};
+    double             _analysisPosition {0.};  // nominal start of the next frame in the input
+    size_t             _naturalPosition {0};    // where the previous frame's waveform goes on in the input
+    bool               _hasPrevious {false};
+};
@@ -0,0 +1,176 @@
+#include "Waveform.h"
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+WaveformPeak merge(WaveformPeak a, WaveformPeak b)
+{
+    return {std::min(a.min, b.min), std::max(a.max, b.max)};
+}
+
+// rounded outwards so quiet audio doesn't vanish
+WaveformPeak quantize(float min, float max)
+{
+    WaveformPeak peak;
+    peak.min = int8_t(std::floor(std::clamp(min, -1.f, 1.f) * Waveform::kPeakScale));
+    peak.max = int8_t(std::ceil(std::clamp(max, -1.f, 1.f) * Waveform::kPeakScale));
+    return peak;
+}
+
+// sizes of the levels for that many buckets, finest first
+std::vector<size_t> levelStarts(size_t bucketCount)
+{
+    std::vector<size_t> starts;
+    if (bucketCount == 0)
+    {
+        return starts;
+    }
+    starts.push_back(0);
+    for (size_t size = bucketCount;; size = (size + 1) / 2)
+    {
+        starts.push_back(starts.back() + size);
+        if (size == 1)
+        {
+            break;
+        }
+    }
+    return starts;
+}
+}  // namespace
+
+Waveform::Waveform(std::vector<WaveformPeak> buckets)
+    : _peaks(std::move(buckets))
+    , _levelStarts(levelStarts(_peaks.size()))
+{
+    if (_peaks.empty())
+    {
+        return;
+    }
+
+    _peaks.resize(_levelStarts.back());
+    for (size_t level = 1; level + 1 < _levelStarts.size(); ++level)
+    {
+        size_t below     = _levelStarts[level - 1];
+        size_t belowSize = _levelStarts[level] - below;
+        for (size_t i = 0; i < _levelStarts[level + 1] - _levelStarts[level]; ++i)
+        {
+            // an odd one out at the end is carried up alone
+            WaveformPeak peak = _peaks[below + 2 * i];
+            if (2 * i + 1 < belowSize)
+            {
+                peak = merge(peak, _peaks[below + 2 * i + 1]);
+            }
+            _peaks[_levelStarts[level] + i] = peak;
+        }
+    }
+}
+
+std::optional<WaveformPeak> Waveform::range(int64_t startMs, int64_t endMs) const
+{
+    if (_peaks.empty() || endMs <= 0 || startMs >= duration())
+    {
+        return std::nullopt;
+    }
+    startMs = std::max<int64_t>(startMs, 0);
+    endMs   = std::max(endMs, startMs + 1);
+
+    // buckets of at most half the span, so the ends overshoot by little, and still no more than five of them
+    size_t  level    = 0;
+    int64_t bucketMs = kBucketMs;
+    while (level + 2 < _levelStarts.size() && bucketMs * 4 <= endMs - startMs)
+    {
+        ++level;
+        bucketMs *= 2;
+    }
+    size_t levelSize = _levelStarts[level + 1] - _levelStarts[level];
+    size_t first     = size_t(startMs / bucketMs);
+    size_t last      = std::min(size_t((endMs - 1) / bucketMs), levelSize - 1);
+
+    WaveformPeak peak = _peaks[_levelStarts[level] + first];
+    for (size_t i = first + 1; i <= last; ++i)
+    {
+        peak = merge(peak, _peaks[_levelStarts[level] + i]);
+    }
+    return peak;
+}
+
+// The finest level's bucket count as 32 bits, then the peaks of every level
+std::string Waveform::encode() const
+{
+    uint32_t    count = uint32_t(bucketCount());
+    std::string data(sizeof(count) + _peaks.size() * sizeof(WaveformPeak), '\0');
+    std::memcpy(data.data(), &count, sizeof(count));
+    if (!_peaks.empty())
+    {
+        std::memcpy(data.data() + sizeof(count), _peaks.data(), _peaks.size() * sizeof(WaveformPeak));
+    }
+    return data;
+}
+
+Waveform Waveform::decode(const void* data, size_t size)
+{
+    Waveform waveform;
+    uint32_t count = 0;
+    if (!data || size < sizeof(count))
+    {
+        return waveform;
+    }
+    std::memcpy(&count, data, sizeof(count));
+
+    std::vector<size_t> starts = levelStarts(count);
+    size_t              total  = starts.empty() ? 0 : starts.back();
+    if (total == 0 || size != sizeof(count) + total * sizeof(WaveformPeak))
+    {
+        // not written by this version, treated as missing
+        return waveform;
+    }
+    waveform._peaks.resize(total);
+    std::memcpy(waveform._peaks.data(), static_cast<const char*>(data) + sizeof(count), total * sizeof(WaveformPeak));
+    waveform._levelStarts = std::move(starts);
+    return waveform;
+}
+
+WaveformBuilder::WaveformBuilder(int sampleRate, int channels)
+    : _sampleRate(sampleRate)
+    , _channels(channels)
+{
+}
+
+void WaveformBuilder::feed(const float* samples, size_t frames)
+{
+    while (frames > 0)
+    {
+        // bucket ends computed from the start every time, rates not dividing evenly don't drift
+        int64_t bucketEnd = int64_t(_buckets.size() + 1) * _sampleRate * Waveform::kBucketMs / 1000;
+        size_t  length    = size_t(std::min<int64_t>(int64_t(frames), bucketEnd - _frame));
+
+        float min = 0.f;
+        float max = 0.f;
+        rangeOf(samples, length * size_t(_channels), min, max);
+        _min           = _bucketStarted ? std::min(_min, min) : min;
+        _max           = _bucketStarted ? std::max(_max, max) : max;
+        _bucketStarted = true;
+
+        samples += length * size_t(_channels);
+        frames -= length;
+        _frame += int64_t(length);
+        if (_frame == bucketEnd)
+        {
+            _buckets.push_back(quantize(_min, _max));
+            _bucketStarted = false;
+        }
+    }
+}
+
+Waveform WaveformBuilder::finish()
+{
+    if (_bucketStarted)
+    {
+        _buckets.push_back(quantize(_min, _max));
+        _bucketStarted = false;
+    }
+    return Waveform(std::move(_buckets));
+}
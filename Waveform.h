@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Lowest and highest sample of a stretch of audio, scaled to -127..127
+struct WaveformPeak
+{
+    int8_t min {0};
+    int8_t max {0};
+};
+
+// Overview of one file's audio for drawing, a min/max pyramid. The finest level has a peak per kBucketMs, every
+// level above merges pairs of the one below, up to a single peak for the whole file. Any stretch of the file is
+// answered from a level a few times finer than it, a handful of peaks whatever its length.
+class Waveform
+{
+public:
+    static const int64_t   kBucketMs  = 50;
+    static constexpr float kPeakScale = 127.f;  // a peak of 1.0
+
+    Waveform() = default;
+    // Builds the levels above the finest one
+    explicit Waveform(std::vector<WaveformPeak> buckets);
+
+    bool empty() const
+    {
+        return _peaks.empty();
+    }
+
+    // ms covered by the finest level
+    int64_t duration() const
+    {
+        return int64_t(bucketCount()) * kBucketMs;
+    }
+
+    // Peak of the audio between two positions in the file, null outside of it
+    std::optional<WaveformPeak> range(int64_t startMs, int64_t endMs) const;
+
+    // Compact form stored in the library, the whole pyramid so loading is a copy
+    std::string     encode() const;
+    static Waveform decode(const void* data, size_t size);
+
+private:
+    size_t bucketCount() const
+    {
+        return _levelStarts.size() > 1 ? _levelStarts[1] : 0;
+    }
+
+    std::vector<WaveformPeak> _peaks;        // every level, finest first
+    std::vector<size_t>       _levelStarts;  // where each level starts in _peaks, plus its end
+};
+
+// Builds a file's waveform from its samples, fed block by block
+class WaveformBuilder
+{
+public:
+    WaveformBuilder(int sampleRate, int channels);
+
+    void     feed(const float* samples, size_t frames);
+    // Ends the last bucket, even if it's short
+    Waveform finish();
+
+private:
+    int                       _sampleRate {0};
+    int                       _channels {0};
+    int64_t                   _frame {0};
+    bool                      _bucketStarted {false};
+    float                     _min {0.f};  // of the bucket in progress
+    float                     _max {0.f};
+    std::vector<WaveformPeak> _buckets;
+};
@@ -10,6 +10,8 @@
 #include "AudiobookPlayer.h"
 #include "sqlite3pp/sqlite3pp.h"
 #include "imFileBroser.h"
+#include <cmath>
+#include <mutex>
 #include <stdio.h>
 
 // About Desktop OpenGL function loaders:
@@ -55,6 +57,14 @@ using namespace gl;
 #pragma comment(lib, "legacy_stdio_definitions")
 #endif
 
+// ImGui needs a couple of frames to settle after input (hover, layout of newly opened widgets)
+static const int kFramesAfterWake = 3;
+
+// the player outlives glfwTerminate, its background threads must stop posting events before that. Checked and posted
+// under the mutex, so shutdown can't slip in between.
+static std::mutex sWakeMutex;
+static bool       sWakeEnabled {true};
+
 static void glfw_error_callback(int error, const char* description)
 {
     fprintf(stderr, "Glfw Error %d: %s\n", error, description);
@@ -160,6 +170,13 @@ int main(int, char**)
 
     // init player
     AudiobookPlayer   player;
+    player.setWakeCallback([]() {
+        std::lock_guard<std::mutex> lock(sWakeMutex);
+        if (sWakeEnabled)
+        {
+            glfwPostEmptyEvent();
+        }
+    });
     const char* const args[] = {
         "--intf",
         "dummy",  //
@@ -194,7 +211,8 @@ int main(int, char**)
     // Our state
     bool   show_demo_window = false;
 
-    // Main loop
+    // Main loop, sleeps in glfwWaitEvents until input arrives, the player asks for a frame or its timeout passes
+    int pendingFrames = kFramesAfterWake;
     while (!glfwWindowShouldClose(window))
     {
         // Poll and handle events (inputs, window resize, etc.)
@@ -206,7 +224,24 @@ int main(int, char**)
         // data to your main application. Generally you may always pass all inputs
         // to dear imgui, and hide them from your application based on those two
         // flags.
-        glfwPollEvents();
+        double idleTimeout = player.idleTimeout();
+        if (pendingFrames > 0 || idleTimeout <= 0 || show_demo_window)
+        {
+            glfwPollEvents();
+        }
+        else
+        {
+            if (std::isinf(idleTimeout))
+            {
+                glfwWaitEvents();
+            }
+            else
+            {
+                glfwWaitEventsTimeout(idleTimeout);
+            }
+            pendingFrames = kFramesAfterWake;
+        }
+        pendingFrames = pendingFrames > 0 ? pendingFrames - 1 : 0;
 
         // Start the Dear ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -254,6 +289,10 @@ int main(int, char**)
     }
 
     // Cleanup
+    {
+        std::lock_guard<std::mutex> lock(sWakeMutex);
+        sWakeEnabled = false;
+    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();